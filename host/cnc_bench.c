@@ -0,0 +1,131 @@
+/*
+ * cnc_bench.c
+ *
+ * Measures cnc engine throughput on host: a fixed stream of planned lines,
+ * rapids and pauses is run for a number of simulated seconds, a few times.
+ * The fastest run of each simulated millisecond is summed up and printed as
+ * engine ticks per second of host time and, on x86, as cpu cycles per
+ * engine tick. Time includes the mock port write, and for
+ * dma wave mode streaming the words to the mock port.
+ *
+ * Usage: cnc_bench [seconds] [mixed|planned|rapid]
+ *
+ * Mixed runs the stream as is, planned runs all its lines planned and
+ * rapid runs them all as rapids. Planned lines are what bresenham stepping
+ * of CONFIG_CNC_BRESENHAM speeds up, compare it with the tick engine of
+ * independent axis accumulators there.
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: agent
+ */
+
+#include "cnc_control.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_CYCLES() __rdtsc()
+#else
+#define BENCH_CYCLES() 0
+#endif
+
+#define BENCH_RUNS          7
+
+// engine sources of make SRC= before probing take no probe callback
+#ifdef CNC_SENSE_EXTI_LINE
+#define BENCH_CNC_INIT()    CNC_init(NULL, NULL, NULL, NULL, NULL)
+#else
+#define BENCH_CNC_INIT()    CNC_init(NULL, NULL, NULL, NULL)
+#endif
+
+enum bench_mode {
+  BENCH_MIXED = 0,
+  BENCH_PLANNED,
+  BENCH_RAPID,
+};
+
+// steps and frequency in Hz of x, y and z, rapid, or pause in ms
+static const s32_t stream[][8] = {
+    {800, 4000, 400, 2000, 0, 0, 0, 0},
+    {400, 2000, 800, 4000, 100, 500, 0, 0},
+    {-300, 4000, 200, 2666, 0, 0, 0, 0},
+    {0, 0, 0, 0, -500, 2000, 1, 0},
+    {1200, 4000, -100, 333, 50, 166, 0, 0},
+    {0, 0, 0, 0, 0, 0, 0, 5},
+    {-1200, 4000, 0, 0, 0, 0, 0, 0},
+    {50, 2857, 60, 3428, 70, 4000, 0, 0},
+    {900, 4000, -900, 4000, 300, 1333, 1, 0},
+    {-900, 4000, 900, 4000, -300, 1333, 1, 0},
+};
+#define STREAM_LEN (sizeof(stream)/sizeof(stream[0]))
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void latch(u32_t i, enum bench_mode mode) {
+  const s32_t *m = stream[i];
+  s32_t steps[AXES_COUNT] = {0};
+  u32_t freq[AXES_COUNT] = {0};
+  int a;
+  if (m[7]) {
+    CNC_latch_pause(m[7]);
+    return;
+  }
+  for (a = 0; a < 3; a++) {
+    steps[a] = m[2*a];
+    freq[a] = (u32_t)m[2*a + 1] << CNC_FP_DECIMALS;
+  }
+  CNC_latch(steps, freq, mode == BENCH_RAPID || (mode == BENCH_MIXED && m[6]));
+}
+
+int main(int argc, char **argv) {
+  u32_t secs = argc > 1 ? atoi(argv[1]) : 4;
+  enum bench_mode mode = BENCH_MIXED;
+  if (argc > 2) {
+    mode = strcmp(argv[2], "rapid") == 0 ? BENCH_RAPID :
+        strcmp(argv[2], "planned") == 0 ? BENCH_PLANNED : BENCH_MIXED;
+  }
+  u32_t ms_ticks = CNC_TIMER_FREQ/1000;
+  u32_t n = secs * 1000;
+  // each run does the same work per millisecond, keeping the fastest of
+  // each millisecond filters out host preemption
+  double *best_t = malloc(n * sizeof(double));
+  u64_t *best_c = malloc(n * sizeof(u64_t));
+  double t = 0;
+  u64_t c = 0;
+  u32_t ms;
+  int run;
+  for (run = 0; run < BENCH_RUNS; run++) {
+    u32_t i = 0;
+    HOST_port_reset(FALSE);
+    BENCH_CNC_INIT();
+    CNC_set_enabled(TRUE);
+    CNC_pipeline_enable(TRUE);
+    for (ms = 0; ms < n; ms++) {
+      while (CNC_is_latch_free() && (CNC_get_status() & (1<<CNC_STATUS_BIT_PIPE_EMPTY))) {
+        latch(i, mode);
+        i = (i + 1) % STREAM_LEN;
+      }
+      double t0 = now();
+      u64_t c0 = BENCH_CYCLES();
+      HOST_run(ms_ticks);
+      u64_t dc = BENCH_CYCLES() - c0;
+      double dt = now() - t0;
+      best_t[ms] = run == 0 ? dt : MIN(best_t[ms], dt);
+      best_c[ms] = run == 0 ? dc : MIN(best_c[ms], dc);
+    }
+  }
+  for (ms = 0; ms < n; ms++) {
+    t += best_t[ms];
+    c += best_c[ms];
+  }
+  printf("%.0f ticks/s %.1f cycles/tick\n",
+      (double)n * ms_ticks / t, (double)c / ((u64_t)n * ms_ticks));
+  free(best_t);
+  free(best_c);
+  return 0;
+}
@@ -0,0 +1,235 @@
+/*
+ * cnc_seq.c
+ *
+ * Runs the cnc engine on host through a sequence of latch, pipe and control
+ * commands, read from given file or stdin. Port writes are printed as
+ * "tick bsrr" lines in engine ticks, command results as "#" lines.
+ *
+ * Usage: cnc_seq [-t] [file]
+ *
+ * With -t the engine is run by CNC_timer each tick whatever the engine
+ * mode, as reference of the step timer engine.
+ *
+ * The engine runs in steps of a millisecond, after each the pipe is fed if
+ * a motion was loaded, like the comm task does on target. One command per
+ * line, frequencies are in Hz and times in milliseconds:
+ *
+ *   config <code> <value>      CNC_set_config_specific, comm_proto_cnc.h codes
+ *   enable <0|1>               CNC_set_enabled
+ *   pipe <0|1>                 CNC_pipeline_enable
+ *   latch <steps> <freq> .. [rapid]
+ *                              steps and frequency of each axis, waits for latch
+ *   pause <ms>                 latches pause, waits for latch
+ *   arc <plane> <c0> <c1> <e0> <e1> <ccw> <feed>
+ *                              latches arc, waits for latch
+ *   imm <steps> <freq> ..      overwrites current motion
+ *   hold <0|1>                 feed hold
+ *   override <percent>         feed override
+ *   flush                      flushes pipe
+ *   reset                      resets engine
+ *   home <axes>                homes axes mask
+ *   switch <axis> <pos> <positive>
+ *                              places limit switch at motor position
+ *   probe <0|1>                enables probing
+ *   contact                    probe touches
+ *   run <ms>                   runs engine
+ *   wait                       runs engine until still, pipe empty, latch free
+ *   pos                        prints position, machine position and motors
+ *   dump                       prints engine state, CNC_dump
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: agent
+ */
+
+#include "cnc_control.h"
+#include "comm_proto_cnc.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// longest wait for engine, in ms
+#define SEQ_TIMEOUT         (600*1000)
+
+static struct {
+  u32_t per_tick;
+  u32_t loaded;
+  u32_t printed;
+  u32_t line;
+} seq;
+
+static void pipe_cb(u32_t id) {
+  seq.loaded = TRUE;
+}
+
+static void fail(const char *what) {
+  fflush(stdout);
+  fprintf(stderr, "line %u: %s\n", seq.line, what);
+  exit(1);
+}
+
+// runs engine for a millisecond
+static void step_ms() {
+#ifndef CONFIG_CNC_DMA_WAVE
+  if (seq.per_tick) {
+    HOST_run_ticks(CNC_TIMER_FREQ/1000);
+  } else
+#endif
+  {
+    HOST_run(CNC_TIMER_FREQ/1000);
+  }
+  if (seq.loaded) {
+    seq.loaded = FALSE;
+    CNC_pipeline_feed();
+  }
+}
+
+static void wait_latch() {
+  u32_t ms = 0;
+  while (!CNC_is_latch_free()) {
+    if (++ms > SEQ_TIMEOUT) {
+      fail("latch timeout");
+    }
+    step_ms();
+  }
+}
+
+static u32_t done() {
+  u32_t sr = CNC_get_status();
+  return (sr & (1<<CNC_STATUS_BIT_MOVEMENT_STILL)) &&
+      (sr & (1<<CNC_STATUS_BIT_PIPE_EMPTY)) &&
+      (sr & (1<<CNC_STATUS_BIT_HOMING)) == 0 &&
+      CNC_is_latch_free();
+}
+
+static void report(const char *cmd, u32_t res) {
+  if ((s32_t)res < 0) {
+    printf("# %s error %i\n", cmd, (s32_t)res);
+  }
+}
+
+// parses axis steps and frequencies, returns number of words parsed
+static int parse_axes(char **args, int n, s32_t *steps, u32_t *freq) {
+  int a;
+  for (a = 0; a < AXES_COUNT; a++) {
+    steps[a] = 0;
+    freq[a] = 0;
+    if (2*a + 1 < n) {
+      steps[a] = strtol(args[2*a], NULL, 0);
+      freq[a] = strtoul(args[2*a + 1], NULL, 0) << CNC_FP_DECIMALS;
+    }
+  }
+  return MIN(n, 2*AXES_COUNT);
+}
+
+static void exec(char **w, int n) {
+  s32_t steps[AXES_COUNT];
+  u32_t freq[AXES_COUNT];
+  const char *cmd = w[0];
+#define ARG(i) (n > (i) ? strtol(w[i], NULL, 0) : 0)
+  if (strcmp(cmd, "config") == 0) {
+    CNC_set_config_specific(ARG(1), ARG(2));
+  } else if (strcmp(cmd, "enable") == 0) {
+    CNC_set_enabled(ARG(1));
+  } else if (strcmp(cmd, "pipe") == 0) {
+    CNC_pipeline_enable(ARG(1));
+  } else if (strcmp(cmd, "latch") == 0) {
+    int i = 1 + parse_axes(&w[1], n - 1, steps, freq);
+    u32_t rapid = i < n && strcmp(w[i], "rapid") == 0;
+    wait_latch();
+    report(cmd, CNC_latch(steps, freq, rapid));
+  } else if (strcmp(cmd, "pause") == 0) {
+    wait_latch();
+    report(cmd, CNC_latch_pause(ARG(1)));
+  } else if (strcmp(cmd, "arc") == 0) {
+    wait_latch();
+    report(cmd, CNC_latch_arc(ARG(1), ARG(2), ARG(3), ARG(4), ARG(5), ARG(6),
+        (u32_t)ARG(7) << CNC_FP_DECIMALS));
+  } else if (strcmp(cmd, "imm") == 0) {
+    parse_axes(&w[1], n - 1, steps, freq);
+    CNC_set_imm(steps, freq);
+  } else if (strcmp(cmd, "hold") == 0) {
+    CNC_feed_hold(ARG(1));
+  } else if (strcmp(cmd, "override") == 0) {
+    CNC_set_feed_override(ARG(1));
+  } else if (strcmp(cmd, "flush") == 0) {
+    CNC_pipeline_flush();
+  } else if (strcmp(cmd, "reset") == 0) {
+    CNC_reset();
+  } else if (strcmp(cmd, "home") == 0) {
+    CNC_home(ARG(1));
+  } else if (strcmp(cmd, "switch") == 0) {
+    HOST_port_switch(ARG(1), ARG(2), ARG(3));
+  } else if (strcmp(cmd, "probe") == 0) {
+    CNC_set_probe(ARG(1));
+  } else if (strcmp(cmd, "contact") == 0) {
+    CNC_probe_irq();
+  } else if (strcmp(cmd, "run") == 0) {
+    u32_t ms = ARG(1);
+    while (ms--) {
+      step_ms();
+    }
+  } else if (strcmp(cmd, "wait") == 0) {
+    u32_t ms = 0;
+    while (!done()) {
+      if (++ms > SEQ_TIMEOUT) {
+        fail("wait timeout");
+      }
+      step_ms();
+    }
+  } else if (strcmp(cmd, "pos") == 0) {
+    s32_t pos[AXES_COUNT];
+    int a;
+    printf("# pos");
+    CNC_get_pos(pos);
+    for (a = 0; a < AXES_COUNT; a++) printf(" %i", pos[a]);
+    printf(" machine");
+    CNC_get_machine_pos(pos);
+    for (a = 0; a < AXES_COUNT; a++) printf(" %i", pos[a]);
+    printf(" motor");
+    HOST_port_motor(pos);
+    for (a = 0; a < AXES_COUNT; a++) printf(" %i", pos[a]);
+    printf(" sr %08x\n", CNC_get_status());
+  } else if (strcmp(cmd, "dump") == 0) {
+    CNC_dump();
+  } else {
+    fail("unknown command");
+  }
+#undef ARG
+}
+
+int main(int argc, char **argv) {
+  char buf[256];
+  FILE *f = stdin;
+  if (argc > 1 && strcmp(argv[1], "-t") == 0) {
+#ifdef CONFIG_CNC_DMA_WAVE
+    fprintf(stderr, "dma wave engine never writes port from CNC_timer\n");
+    return 1;
+#endif
+    seq.per_tick = TRUE;
+    argc--;
+    argv++;
+  }
+  if (argc > 1 && (f = fopen(argv[1], "r")) == NULL) {
+    perror(argv[1]);
+    return 1;
+  }
+  HOST_port_reset(TRUE);
+  CNC_init(NULL, pipe_cb, NULL, NULL, NULL);
+  while (fgets(buf, sizeof(buf), f)) {
+    char *w[16];
+    int n = 0;
+    char *t = strtok(buf, " \t\r\n");
+    seq.line++;
+    while (t && *t != '#' && n < 16) {
+      w[n++] = t;
+      t = strtok(NULL, " \t\r\n");
+    }
+    if (n == 0) {
+      continue;
+    }
+    exec(w, n);
+    HOST_port_print(seq.printed);
+    seq.printed = HOST_port_writes(NULL);
+  }
+  printf("# end tick %u\n", HOST_tick());
+  return 0;
+}
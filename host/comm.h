@@ -0,0 +1,16 @@
+/*
+ * comm.h
+ *
+ * Host stand in for the generic comm stack header, the cnc engine only
+ * needs the protocol constants of comm_proto_cnc.h.
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: agent
+ */
+
+#ifndef COMM_H_
+#define COMM_H_
+
+#include "system.h"
+
+#endif /* COMM_H_ */
@@ -0,0 +1,8 @@
+/*
+ * config_header.h
+ *
+ * Host stand in for the header generated from config.mk, empty on host.
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: agent
+ */
@@ -0,0 +1,237 @@
+/*
+ * host_port.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: agent
+ */
+
+#include "host_port.h"
+#include "cnc_control.h"
+#include "led.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+
+static const u16_t step_pin[AXES_COUNT] = {
+    CNC_GPIO_STEP_X, CNC_GPIO_STEP_Y, CNC_GPIO_STEP_Z,
+#if CNC_AXES > 3
+    CNC_GPIO_STEP_A,
+#endif
+};
+static const u16_t dir_pin[AXES_COUNT] = {
+    CNC_GPIO_DIR_X, CNC_GPIO_DIR_Y, CNC_GPIO_DIR_Z,
+#if CNC_AXES > 3
+    CNC_GPIO_DIR_A,
+#endif
+};
+#ifdef CNC_GPIO_LIMIT_X
+static const u16_t limit_pin[AXES_COUNT] = {
+    CNC_GPIO_LIMIT_X, CNC_GPIO_LIMIT_Y, CNC_GPIO_LIMIT_Z,
+#if CNC_AXES > 3
+    CNC_GPIO_LIMIT_A,
+#endif
+};
+#else
+// engine sources of make SRC= may predate limit switches, none ever close
+static const u16_t limit_pin[AXES_COUNT];
+#define CNC_limit_irq(a)
+#endif
+
+volatile u32_t HOST_port_idr;
+
+static struct {
+  u32_t tick;
+  u32_t odr;
+  u32_t record;
+  HOST_Write_t *writes;
+  u32_t count;
+  u32_t size;
+  s32_t motor[AXES_COUNT];
+  /* Placed limit switches */
+  u32_t switch_axes;
+  u32_t switch_positive;
+  s32_t switch_pos[AXES_COUNT];
+  /* Switches closed during an engine run */
+  u32_t limit_pending;
+#ifdef CONFIG_CNC_STEP_TIMER
+  /* Tick of next step timer irq */
+  u32_t step_next;
+#endif
+} host;
+
+void HOST_port_reset(u32_t record) {
+  int a;
+  free(host.writes);
+  memset(&host, 0, sizeof(host));
+  host.record = record;
+  for (a = 0; a < AXES_COUNT; a++) {
+    host.odr |= step_pin[a];
+  }
+  HOST_port_idr = 0xffff;
+#ifdef CONFIG_CNC_STEP_TIMER
+  // step timer first fires a millisecond after start, see CNC_init
+  host.step_next = CNC_TIMER_FREQ/1000 - 1;
+#endif
+}
+
+static void update_switch(u32_t a) {
+  u32_t closed;
+  if ((host.switch_axes & (1<<a)) == 0) {
+    return;
+  }
+  if (host.switch_positive & (1<<a)) {
+    closed = host.motor[a] >= host.switch_pos[a];
+  } else {
+    closed = host.motor[a] <= host.switch_pos[a];
+  }
+  if (closed && (HOST_port_idr & limit_pin[a])) {
+    HOST_port_idr &= ~limit_pin[a];
+    host.limit_pending |= (1<<a);
+  } else if (!closed) {
+    HOST_port_idr |= limit_pin[a];
+  }
+}
+
+// limit irqs run when the engine has returned
+static void limit_irqs() {
+  u32_t a;
+  u32_t pending = host.limit_pending;
+  host.limit_pending = 0;
+  for (a = 0; pending; a++, pending >>= 1) {
+    if (pending & 1) {
+      CNC_limit_irq(a);
+    }
+  }
+}
+
+void HOST_port_write(u32_t bsrr) {
+  int a;
+  u32_t odr = (host.odr & ~(bsrr >> 16)) | (bsrr & 0xffff);
+  if (odr == host.odr) {
+    return;
+  }
+  for (a = 0; a < AXES_COUNT; a++) {
+    if ((odr & ~host.odr) & step_pin[a]) {
+      host.motor[a] += (odr & dir_pin[a]) ? 1 : -1;
+      update_switch(a);
+    }
+  }
+  host.odr = odr;
+  if (!host.record) {
+    return;
+  }
+  if (host.count == host.size) {
+    host.size = host.size ? host.size * 2 : 1024;
+    host.writes = realloc(host.writes, host.size * sizeof(HOST_Write_t));
+    if (host.writes == NULL) {
+      fprintf(stderr, "out of memory recording port\n");
+      exit(1);
+    }
+  }
+  host.writes[host.count].tick = host.tick;
+  host.writes[host.count].bsrr = bsrr;
+  host.count++;
+}
+
+u32_t HOST_port_odr() {
+  return host.odr;
+}
+
+u32_t HOST_port_writes(const HOST_Write_t **w) {
+  if (w) {
+    *w = host.writes;
+  }
+  return host.count;
+}
+
+void HOST_port_print(u32_t from) {
+  u32_t i;
+  for (i = from; i < host.count; i++) {
+    printf("%u %08x\n", host.writes[i].tick, host.writes[i].bsrr);
+  }
+}
+
+void HOST_port_motor(s32_t *pos) {
+  memcpy(pos, host.motor, sizeof(host.motor));
+}
+
+void HOST_port_switch(u32_t a, s32_t pos, u32_t positive) {
+  host.switch_axes |= (1<<a);
+  host.switch_pos[a] = pos;
+  host.switch_positive = (host.switch_positive & ~(1<<a)) | (positive ? (1<<a) : 0);
+  update_switch(a);
+  // placing a switch is no closing edge
+  host.limit_pending &= ~(1<<a);
+}
+
+u32_t HOST_tick() {
+  return host.tick;
+}
+
+void HOST_run(u32_t ticks) {
+#if defined(CONFIG_CNC_STEP_TIMER)
+  u32_t end = host.tick + ticks;
+  // irq at tick t runs the engine for the ticks up to and including t
+  while ((s32_t)(end - host.step_next) > 0) {
+    host.tick = host.step_next;
+    host.step_next += CNC_step_timer();
+    limit_irqs();
+  }
+  host.tick = end;
+#elif defined(CONFIG_CNC_DMA_WAVE)
+  u32_t end = host.tick + ticks;
+  u32_t words[CNC_WAVE_BLOCK];
+  while (host.tick != end) {
+    u32_t i;
+    u32_t n = MIN(CNC_WAVE_BLOCK, end - host.tick);
+    CNC_wave_block(words, n);
+    for (i = 0; i < n; i++) {
+      // zero word leaves port as is
+      if (words[i]) {
+        HOST_port_write(words[i]);
+      }
+      host.tick++;
+    }
+    limit_irqs();
+  }
+#else
+  HOST_run_ticks(ticks);
+#endif
+}
+
+#ifndef CONFIG_CNC_DMA_WAVE
+void HOST_run_ticks(u32_t ticks) {
+  while (ticks--) {
+    CNC_timer();
+    limit_irqs();
+    host.tick++;
+  }
+}
+#endif
+
+// target stand ins
+
+void enter_critical() {
+}
+
+void exit_critical() {
+}
+
+void print(const char *f, ...) {
+  va_list ap;
+  va_start(ap, f);
+  vprintf(f, ap);
+  va_end(ap);
+}
+
+void LED_enable(led_t led) {
+}
+
+void LED_disable(led_t led) {
+}
+
+void LED_blink(led_t led, u8_t cycle, u8_t duty, u8_t blinks) {
+}
+
+void LED_blink_single(u8_t led_ix, u8_t cycle, u8_t duty, u8_t blinks) {
+}
@@ -0,0 +1,91 @@
+/*
+ * host_port.h
+ *
+ * Mock cnc port for running the cnc engine on a host. Engine port writes
+ * are recorded with the engine tick they happen in, and the engine is
+ * clocked the way the configured engine mode clocks it on target.
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: agent
+ */
+
+#ifndef HOST_PORT_H_
+#define HOST_PORT_H_
+
+#include "types.h"
+
+#define CNC_GPIO_DEF(set, reset) \
+  HOST_port_write((set) | ((reset)<<16))
+#define CNC_GPIO_DEF_READ() \
+  (HOST_port_idr)
+#define CNC_GPIO_LIMIT_READ() \
+  (HOST_port_idr)
+
+/**
+ * Port write as recorded by the mock port
+ */
+typedef struct HOST_Write_s {
+  /* Engine tick of write */
+  u32_t tick;
+  /* BSRR word written */
+  u32_t bsrr;
+} HOST_Write_t;
+
+/* Input data register as read by the engine, limit and sense pins */
+extern volatile u32_t HOST_port_idr;
+
+/**
+ * Clears recorded writes, motor positions, switches and port state. Port
+ * starts at tick zero with step pins at rest, high, other outputs low and
+ * all switch inputs open, high. Writes are only recorded if record.
+ */
+void HOST_port_reset(u32_t record);
+/**
+ * Engine port write. Writes leaving the port as it is are not recorded.
+ */
+void HOST_port_write(u32_t bsrr);
+/**
+ * Returns output data register of port.
+ */
+u32_t HOST_port_odr();
+/**
+ * Returns number of recorded writes, and the writes in w if not null.
+ */
+u32_t HOST_port_writes(const HOST_Write_t **w);
+/**
+ * Prints recorded writes from given index as "tick bsrr" lines.
+ */
+void HOST_port_print(u32_t from);
+/**
+ * Copies motor positions in steps, counted on step pin rising edges by the
+ * dir pin each step pin is sampled with.
+ */
+void HOST_port_motor(s32_t *pos);
+
+/**
+ * Places limit switch of given axis at given motor position, closed at and
+ * beyond it in positive direction if positive, else in negative direction.
+ * A closing switch calls CNC_limit_irq once the engine run it closed in has
+ * returned, like an irq of same priority as the engine.
+ */
+void HOST_port_switch(u32_t a, s32_t pos, u32_t positive);
+
+/**
+ * Returns current engine tick.
+ */
+u32_t HOST_tick();
+/**
+ * Runs the engine for given number of ticks: the system timer calling
+ * CNC_timer each tick, the step timer calling CNC_step_timer when it
+ * fires, or dma streaming words of CNC_wave_block to the port.
+ */
+void HOST_run(u32_t ticks);
+#ifndef CONFIG_CNC_DMA_WAVE
+/**
+ * Runs the engine for given number of ticks by calling CNC_timer each tick,
+ * also in step timer mode as reference of the scheduled engine.
+ */
+void HOST_run_ticks(u32_t ticks);
+#endif
+
+#endif /* HOST_PORT_H_ */
@@ -0,0 +1,15 @@
+/*
+ * miniutils.h
+ *
+ * Host stand in for the generic miniutils header.
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: agent
+ */
+
+#ifndef MINIUTILS_H_
+#define MINIUTILS_H_
+
+#include "system.h"
+
+#endif /* MINIUTILS_H_ */
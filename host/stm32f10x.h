@@ -0,0 +1,47 @@
+/*
+ * stm32f10x.h
+ *
+ * Host stand in for the device header, only what the cnc engine and its
+ * configuration refer to.
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: agent
+ */
+
+#ifndef STM32F10X_H_
+#define STM32F10X_H_
+
+#include "types.h"
+
+typedef struct {
+  volatile u32_t CRL;
+  volatile u32_t CRH;
+  volatile u32_t IDR;
+  volatile u32_t ODR;
+  volatile u32_t BSRR;
+  volatile u32_t BRR;
+  volatile u32_t LCKR;
+} GPIO_TypeDef;
+
+extern GPIO_TypeDef *GPIOE;
+
+#define GPIO_Pin_0    ((u16_t)0x0001)
+#define GPIO_Pin_1    ((u16_t)0x0002)
+#define GPIO_Pin_2    ((u16_t)0x0004)
+#define GPIO_Pin_3    ((u16_t)0x0008)
+#define GPIO_Pin_4    ((u16_t)0x0010)
+#define GPIO_Pin_5    ((u16_t)0x0020)
+#define GPIO_Pin_6    ((u16_t)0x0040)
+#define GPIO_Pin_7    ((u16_t)0x0080)
+#define GPIO_Pin_8    ((u16_t)0x0100)
+#define GPIO_Pin_9    ((u16_t)0x0200)
+#define GPIO_Pin_10   ((u16_t)0x0400)
+#define GPIO_Pin_11   ((u16_t)0x0800)
+#define GPIO_Pin_12   ((u16_t)0x1000)
+#define GPIO_Pin_13   ((u16_t)0x2000)
+#define GPIO_Pin_14   ((u16_t)0x4000)
+#define GPIO_Pin_15   ((u16_t)0x8000)
+
+#define __DMB()       __sync_synchronize()
+
+#endif /* STM32F10X_H_ */
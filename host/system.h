@@ -0,0 +1,60 @@
+/*
+ * system.h
+ *
+ * Host stand in for the generic system header. The mock cnc port is
+ * included first so its CNC_GPIO_DEF replaces the one of system_config.h.
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: agent
+ */
+
+#ifndef SYSTEM_H_
+#define SYSTEM_H_
+
+#include "host_port.h"
+
+// engine mode is the one of the makefile variant, whatever system_config.h
+// of the engine sources enables
+#ifdef CONFIG_CNC_BRESENHAM
+#define HOST_CNC_BRESENHAM
+#endif
+#ifdef CONFIG_CNC_STEP_TIMER
+#define HOST_CNC_STEP_TIMER
+#endif
+#ifdef CONFIG_CNC_DMA_WAVE
+#define HOST_CNC_DMA_WAVE
+#endif
+
+#include "system_config.h"
+
+#ifndef HOST_CNC_BRESENHAM
+#undef CONFIG_CNC_BRESENHAM
+#endif
+#ifndef HOST_CNC_STEP_TIMER
+#undef CONFIG_CNC_STEP_TIMER
+#endif
+#ifndef HOST_CNC_DMA_WAVE
+#undef CONFIG_CNC_DMA_WAVE
+#endif
+
+#include <string.h>
+
+#define SYS_CPU_FREQ          72000000
+
+#define MIN(x, y)             ((x) < (y) ? (x) : (y))
+#define MAX(x, y)             ((x) > (y) ? (x) : (y))
+#define ABS(x)                ((x) < 0 ? -(x) : (x))
+
+#define D_APP                 0
+#define D_DEBUG               0
+#define D_INFO                0
+#define D_WARN                0
+#define D_FATAL               0
+#define DBG(mask, level, ...)
+
+void print(const char *f, ...);
+
+void enter_critical();
+void exit_critical();
+
+#endif /* SYSTEM_H_ */
@@ -0,0 +1,182 @@
+/*
+ * test_arc.c
+ *
+ * Accuracy tests of the fixed point arc segment generator of cnc_arc.c
+ * against double precision math, and a generator throughput benchmark.
+ *
+ * Usage: test_arc [bench [seconds]]
+ *
+ * Tests check CORDIC sine, cosine, angle and length, and walk random
+ * arcs and spirals segment by segment: segments must add up to the end
+ * point, stay in bounds, turn the right way round the right angle and
+ * keep points and chords close to the ideal arc. Largest deviations
+ * found are printed. With bench full circles are generated for given
+ * seconds and segments per second of host time are printed.
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: agent
+ */
+
+#include "cnc_arc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+/* Random arcs walked */
+#define ARC_TESTS           2000
+/* Allowed point deviation from ideal arc in steps, half a step rounding
+   of radius and of each axis */
+#define ARC_MAX_POINT_DEV   1.21
+/* Allowed chord error beyond tolerance in steps, rounding of chord ends */
+#define ARC_MAX_CHORD_DEV   1.21
+
+static u32_t failures;
+static u32_t checks;
+static u32_t seed = 1;
+
+static double max_point_dev;
+static double max_chord_dev;
+static double max_sincos_err;
+
+static void check(int line, const char *what, bool ok) {
+  checks++;
+  if (!ok) {
+    printf("line %i: %s failed\n", line, what);
+    failures++;
+  }
+}
+#define CHECK(x) check(__LINE__, #x, (x))
+
+static s32_t rnd(s32_t lo, s32_t hi) {
+  seed = seed * 1103515245 + 12345;
+  return lo + (s32_t)((((u64_t)seed >> 8) * (u64_t)(hi - lo + 1)) >> 24);
+}
+
+static void test_sincos() {
+  u32_t i;
+  for (i = 0; i < 100000; i++) {
+    u32_t a = i * 42949u + (u32_t)rnd(0, 42948);
+    s32_t c, s;
+    double rad = a * (2 * M_PI / 4294967296.0);
+    CNC_ARC_sincos(a, &c, &s);
+    double err = MAX(fabs(c / 1073741824.0 - cos(rad)), fabs(s / 1073741824.0 - sin(rad)));
+    max_sincos_err = MAX(max_sincos_err, err);
+  }
+  CHECK(max_sincos_err < 1e-7);
+  for (i = 0; i < 100000; i++) {
+    s32_t x = rnd(-1000000, 1000000), y = rnd(-1000000, 1000000), len;
+    u32_t a = CNC_ARC_polar(x, y, &len);
+    double ideal = atan2(y, x) * (4294967296.0 / (2 * M_PI));
+    double da = fabs((double)(s32_t)(a - (u32_t)(s64_t)llround(ideal)));
+    if (fabs(len - hypot(x, y)) > 1.0 || da > 64) {
+      printf("polar %i %i: angle %u len %i\n", x, y, a, len);
+      CHECK(FALSE);
+      return;
+    }
+  }
+}
+
+// walks arc of centre c and end e relative to start, checking each segment
+static void walk(s32_t c0, s32_t c1, s32_t e0, s32_t e1, bool ccw, u32_t tol) {
+  CNC_Arc_t arc;
+  s32_t min[2], max[2], d0, d1;
+  s32_t p0 = 0, p1 = 0;
+  double r0 = hypot(c0, c1), r1 = hypot(e0 - c0, e1 - c1);
+  double turned = 0, prev = atan2(-c1, -c0), r_prev = r0;
+  u32_t segs = 0;
+  CNC_ARC_init(&arc, c0, c1, e0, e1, ccw, tol);
+  CNC_ARC_bounds(&arc, min, max);
+  while (CNC_ARC_next(&arc, &d0, &d1)) {
+    double mid0 = p0 + d0 / 2.0 - c0, mid1 = p1 + d1 / 2.0 - c1;
+    p0 += d0;
+    p1 += d1;
+    segs++;
+    // ideal radius at this point of the sweep, spirals change linearly
+    double a = atan2(p1 - c1, p0 - c0);
+    double da = a - prev;
+    if (ccw && da < -1e-9) da += 2 * M_PI;
+    if (!ccw && da > 1e-9) da -= 2 * M_PI;
+    turned += da;
+    prev = a;
+    double r = r0 + (r1 - r0) * fabs(turned) /
+        (arc.sweep * (2 * M_PI / 4294967296.0));
+    double dev = fabs(hypot(p0 - c0, p1 - c1) - r);
+    double chord = (r_prev + r) / 2 - hypot(mid0, mid1) - tol / 1000.0;
+    r_prev = r;
+    max_point_dev = MAX(max_point_dev, dev);
+    max_chord_dev = MAX(max_chord_dev, chord);
+    if (dev > ARC_MAX_POINT_DEV ||
+        chord > ARC_MAX_CHORD_DEV ||
+        p0 < min[0] || p0 > max[0] || p1 < min[1] || p1 > max[1]) {
+      printf("arc c %i %i e %i %i ccw %i tol %u: seg %u at %i %i dev %.2f chord %.2f\n",
+          c0, c1, e0, e1, ccw, tol, segs, p0, p1, dev, chord);
+      CHECK(FALSE);
+      return;
+    }
+  }
+  CHECK(p0 == e0 && p1 == e1);
+  CHECK(segs <= arc.segs);
+  // turned the way of the sweep, full turn if start and end coincide
+  double sweep = arc.sweep * (2 * M_PI / 4294967296.0);
+  CHECK(fabs(fabs(turned) - sweep) < 1e-3 + 2 * M_PI / MAX(1, arc.segs));
+}
+
+static void test_arcs() {
+  u32_t i;
+  // quarter circle, half circle both ways and full circle
+  walk(1000, 0, 1000, 1000, TRUE, 10);
+  walk(1000, 0, 2000, 0, TRUE, 10);
+  walk(1000, 0, 2000, 0, FALSE, 10);
+  walk(0, -5000, 0, 0, TRUE, 100);
+  // tiny and huge radii
+  walk(2, 0, 4, 0, TRUE, 1);
+  walk(0, 1000000, 0, 2000000, FALSE, 1000);
+  for (i = 0; i < ARC_TESTS; i++) {
+    s32_t r = rnd(1, 200000);
+    double a0 = rnd(0, 65535) * (2 * M_PI / 65536);
+    double a1 = rnd(0, 65535) * (2 * M_PI / 65536);
+    // end radius differs a little for spirals
+    double re = r + (i & 1 ? rnd(-r / 20, r / 20) : 0);
+    s32_t c0 = (s32_t)lround(-r * cos(a0)), c1 = (s32_t)lround(-r * sin(a0));
+    s32_t e0 = c0 + (s32_t)lround(re * cos(a1)), e1 = c1 + (s32_t)lround(re * sin(a1));
+    walk(c0, c1, e0, e1, rnd(0, 1), rnd(1, 2000));
+  }
+}
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void bench(double secs) {
+  u64_t segs = 0;
+  double t0 = now(), t;
+  do {
+    CNC_Arc_t arc;
+    s32_t d0, d1;
+    u32_t i;
+    for (i = 0; i < 100; i++) {
+      CNC_ARC_init(&arc, 40000, 0, 0, 0, TRUE, 10);
+      while (CNC_ARC_next(&arc, &d0, &d1)) {
+        segs++;
+      }
+    }
+    t = now() - t0;
+  } while (t < secs);
+  printf("%.0f segments/s\n", segs / t);
+}
+
+int main(int argc, char **argv) {
+  if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+    bench(argc > 2 ? atof(argv[2]) : 2);
+    return 0;
+  }
+  test_sincos();
+  test_arcs();
+  printf("%u checks, %u failed, max sincos error %.1e, point deviation %.2f steps, "
+      "chord error beyond tolerance %.2f steps\n",
+      checks, failures, max_sincos_err, max_point_dev, max_chord_dev);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,304 @@
+/*
+ * test_planner.c
+ *
+ * Unit tests of the motion planner math of cnc_planner.c, and a planner
+ * throughput benchmark.
+ *
+ * Usage: test_planner [bench [motions]]
+ *
+ * Without arguments the tests are run. With bench a stream of short
+ * motions, a polygon approximating a circle, is latched into the pipe
+ * of a stopped engine until given number of motions is latched, flushing
+ * the pipe whenever full. Each latch plans the motion and replans the pipe
+ * backwards as far as entry speeds change. Printed are latched motions per
+ * second of host time and, on x86, cpu cycles per latched motion.
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: agent
+ */
+
+#include "cnc_planner.h"
+#include "comm_proto_cnc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_CYCLES() __rdtsc()
+#else
+#define BENCH_CYCLES() 0
+#endif
+
+static u32_t failures;
+static u32_t checks;
+
+#define CHECK_EQ(x, y) check_eq(__LINE__, #x, (s64_t)(x), (s64_t)(y))
+
+static void check_eq(int line, const char *what, s64_t x, s64_t y) {
+  checks++;
+  if (x != y) {
+    printf("line %i: %s is %lli, expected %lli\n", line, what, (long long)x, (long long)y);
+    failures++;
+  }
+}
+
+static void config(CNC_Config_t *cfg) {
+  int a;
+  memset(cfg, 0, sizeof(*cfg));
+  for (a = 0; a < AXES_COUNT; a++) {
+    cfg->max_freq[a] = 10000;
+    cfg->acc[a] = 1000;
+    cfg->start_freq[a] = 100;
+  }
+}
+
+// queued motion of given steps at dominant axis frequency freq in Hz
+static void motion(CNC_Queued_t *q, s32_t x, s32_t y, s32_t z, u32_t freq, u8_t flags) {
+  s32_t s[3] = {x, y, z};
+  int a;
+  memset(q, 0, sizeof(*q));
+  for (a = 0; a < AXES_COUNT; a++) {
+    q->steps[a] = ABS(s[a]);
+    q->flags |= s[a] > 0 ? (1<<a) : 0;
+  }
+  q->flags |= flags;
+  q->rate = freq << CNC_FP_DECIMALS;
+}
+
+static void test_sqrt() {
+  u64_t x;
+  for (x = 0; x < 100000; x++) {
+    u64_t r = CNC_PLAN_sqrt(x);
+    if (r * r > x || (r + 1) * (r + 1) <= x) {
+      CHECK_EQ(CNC_PLAN_sqrt(x), (u64_t)sqrtl(x));
+      return;
+    }
+  }
+  CHECK_EQ(CNC_PLAN_sqrt(0xffffffffULL * 0xffffffffULL), 0xffffffff);
+  CHECK_EQ(CNC_PLAN_sqrt(0xffffffffffffffffULL), 0xffffffff);
+  CHECK_EQ(CNC_PLAN_sqrt(1ULL << 40), 1 << 20);
+  CHECK_EQ(CNC_PLAN_sqrt((1ULL << 40) - 1), (1 << 20) - 1);
+}
+
+static void test_motion() {
+  CNC_Config_t cfg;
+  CNC_Queued_t q;
+  config(&cfg);
+
+  // 3-4-5 triangle, y dominant at 1 kHz makes path speed 1250
+  motion(&q, 300, -400, 0, 1000, 0);
+  CNC_PLAN_motion(&q, &cfg);
+  CHECK_EQ(q.plan.dom, 1);
+  CHECK_EQ(q.plan.length, 500);
+  CHECK_EQ(q.plan.nominal, 1250);
+  // y acceleration limit scaled to path is the lower
+  CHECK_EQ(q.plan.acc, 1000 * 500 / 400);
+  CHECK_EQ(q.plan.jerk, 0);
+  CHECK_EQ(q.plan.floor, 100 * 500 / 400);
+  CHECK_EQ(q.plan.entry, q.plan.floor);
+  CHECK_EQ(q.plan.exit, q.plan.floor);
+  CHECK_EQ(CNC_PLAN_factor(&q, 0), (300 << CNC_PLAN_FACTOR_Q) / 500);
+  CHECK_EQ(CNC_PLAN_factor(&q, 2), 0);
+
+  // axis max frequency caps nominal speed
+  motion(&q, 300, 400, 0, 20000, 0);
+  CNC_PLAN_motion(&q, &cfg);
+  CHECK_EQ(q.plan.nominal, 10000 * 500 / 400);
+
+  // jerk limit plans s-curve with mean acceleration
+  cfg.jerk[0] = 50000;
+  motion(&q, 300, 400, 0, 1000, 0);
+  CNC_PLAN_motion(&q, &cfg);
+  CHECK_EQ(q.plan.jerk, 50000 * 500 / 300);
+  CHECK_EQ(q.plan.acc, (1000 * 500 / 400) * 2 / 3);
+  cfg.jerk[0] = 0;
+
+  // rapids, pauses and empty motions are not planned
+  motion(&q, 300, 400, 0, 1000, CNC_QUEUED_RAPID);
+  CNC_PLAN_motion(&q, &cfg);
+  CHECK_EQ(q.plan.length, 0);
+  CHECK_EQ(CNC_PLAN_factor(&q, 0), 0);
+  motion(&q, 0, 0, 0, 5, CNC_QUEUED_PAUSE);
+  CNC_PLAN_motion(&q, &cfg);
+  CHECK_EQ(q.plan.length, 0);
+  motion(&q, 0, 0, 0, 1000, 0);
+  CNC_PLAN_motion(&q, &cfg);
+  CHECK_EQ(q.plan.length, 0);
+}
+
+static void test_junction() {
+  CNC_Config_t cfg;
+  CNC_Queued_t p, n;
+  config(&cfg);
+
+  // collinear motions flow through at nominal speed
+  motion(&p, 1000, 0, 0, 2000, 0);
+  motion(&n, 500, 0, 0, 3000, 0);
+  CNC_PLAN_motion(&p, &cfg);
+  CNC_PLAN_motion(&n, &cfg);
+  CHECK_EQ(CNC_PLAN_junction(&p, &n, &cfg), 2000);
+
+  // right angle, each axis jumps its start frequency at most
+  motion(&n, 0, 1000, 0, 2000, 0);
+  CNC_PLAN_motion(&n, &cfg);
+  CHECK_EQ(CNC_PLAN_junction(&p, &n, &cfg), 100);
+
+  // reversal jumps twice the speed, floor of both motions is still safe
+  motion(&n, -1000, 0, 0, 2000, 0);
+  CNC_PLAN_motion(&n, &cfg);
+  CHECK_EQ(CNC_PLAN_junction(&p, &n, &cfg), 100);
+
+  // with junction deviation a corner is capped by it, even where axis
+  // start frequencies would allow jumping faster; the deviation speed of
+  // 30 degrees at 0.01 steps is below motion floors
+  cfg.start_freq[0] = cfg.start_freq[1] = 1000;
+  cfg.junction_dev = 10;
+  motion(&p, 1000, 0, 0, 4000, 0);
+  motion(&n, 1000, 577, 0, 4000, 0);
+  CNC_PLAN_motion(&p, &cfg);
+  CNC_PLAN_motion(&n, &cfg);
+  u32_t v = CNC_PLAN_junction(&p, &n, &cfg);
+  CHECK_EQ(v, MIN(p.plan.floor, n.plan.floor));
+  cfg.junction_dev = 0;
+  CHECK_EQ(CNC_PLAN_junction(&p, &n, &cfg), 2000);
+
+  // near straight join still flows as fast as axis speed jumps allow
+  cfg.start_freq[0] = cfg.start_freq[1] = 100;
+  motion(&n, 1000, 100, 0, 4000, 0);
+  CNC_PLAN_motion(&p, &cfg);
+  CNC_PLAN_motion(&n, &cfg);
+  v = CNC_PLAN_junction(&p, &n, &cfg);
+  cfg.junction_dev = 10;
+  CHECK_EQ(CNC_PLAN_junction(&p, &n, &cfg), v);
+  CHECK_EQ(v > MAX(p.plan.floor, n.plan.floor), TRUE);
+  cfg.junction_dev = 0;
+
+  // unplanned motion on either side stops at floor
+  motion(&n, 1000, 0, 0, 2000, CNC_QUEUED_RAPID);
+  CNC_PLAN_motion(&n, &cfg);
+  CHECK_EQ(CNC_PLAN_junction(&p, &n, &cfg), n.plan.floor);
+}
+
+static void test_profile() {
+  CNC_Config_t cfg;
+  CNC_Queued_t q;
+  CNC_Profile_t p;
+  config(&cfg);
+
+  // trapezoid, ramps of (1000^2 - 100^2) / 2000 = 495 steps and cruise
+  motion(&q, 1000, 0, 0, 1000, 0);
+  CNC_PLAN_motion(&q, &cfg);
+  CNC_PLAN_profile(&p, &q, q.plan.entry, q.plan.exit);
+  CHECK_EQ(p.peak, 1000 << CNC_FP_DECIMALS);
+  CHECK_EQ(p.decel_steps, 495);
+  CHECK_EQ(p.acc_phase_inc, 0);
+  CHECK_EQ(CNC_PLAN_ticks(&q, &cfg),
+      2 * (900 * CNC_TIMER_FREQ / 1000) + 10 * CNC_TIMER_FREQ / 1000);
+
+  // triangle, acceleration meets deceleration halfway
+  motion(&q, 500, 0, 0, 1000, 0);
+  CNC_PLAN_motion(&q, &cfg);
+  CHECK_EQ(CNC_PLAN_reach(&q.plan, 100, 250), CNC_PLAN_sqrt(100 * 100 + 2 * 1000 * 250));
+  CNC_PLAN_profile(&p, &q, q.plan.entry, q.plan.exit);
+  CHECK_EQ(p.peak, CNC_PLAN_reach(&q.plan, 100, 250) << CNC_FP_DECIMALS);
+  CHECK_EQ(p.decel_steps, 250);
+
+  // entry and exit at nominal speed cruise all the way
+  motion(&q, 1000, 0, 0, 1000, 0);
+  CNC_PLAN_motion(&q, &cfg);
+  q.plan.entry = q.plan.exit = q.plan.nominal;
+  CHECK_EQ(CNC_PLAN_ticks(&q, &cfg), CNC_TIMER_FREQ);
+
+  // s-curve profile is at least as long as its trapezoid
+  cfg.jerk[0] = 20000;
+  motion(&q, 1000, 0, 0, 1000, 0);
+  CNC_PLAN_motion(&q, &cfg);
+  CNC_PLAN_profile(&p, &q, q.plan.entry, q.plan.exit);
+  CHECK_EQ(p.acc_phase_inc > 0, TRUE);
+  CHECK_EQ(CNC_PLAN_ticks(&q, &cfg) >= 2 * (900 * CNC_TIMER_FREQ / 1000), TRUE);
+
+  // jerk limited short motion reaches less than its trapezoid, and its
+  // deceleration from peak fits the distance
+  cfg.acc[0] = 100000;
+  motion(&q, 60, 0, 0, 4000, 0);
+  CNC_PLAN_motion(&q, &cfg);
+  u32_t v = CNC_PLAN_reach(&q.plan, 100, 60);
+  CHECK_EQ(v > 100, TRUE);
+  CHECK_EQ(v < CNC_PLAN_sqrt(100 * 100 + 2 * (u64_t)q.plan.acc * 60), TRUE);
+  CNC_PLAN_profile(&p, &q, q.plan.entry, q.plan.exit);
+  CHECK_EQ(p.peak >= p.entry && p.peak >= p.exit, TRUE);
+  CHECK_EQ(p.decel_steps < 60, TRUE);
+  cfg.acc[0] = 1000;
+  cfg.jerk[0] = 0;
+
+  // pause counts down each millisecond and a tick, rapid without ramp
+  motion(&q, 0, 0, 0, 0, CNC_QUEUED_PAUSE);
+  q.rate = 5;
+  CHECK_EQ(CNC_PLAN_ticks(&q, &cfg), 4 * (CNC_TIMER_FREQ/1000 + 1));
+  motion(&q, 1000, 500, 0, 1000, CNC_QUEUED_RAPID);
+  CNC_PLAN_motion(&q, &cfg);
+  CHECK_EQ(CNC_PLAN_ticks(&q, &cfg), 1000 * CNC_TIMER_FREQ / 10000);
+}
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void bench(u32_t motions) {
+  const u32_t segs = 64;
+  s32_t px = 0, py = 0;
+  u32_t i;
+  u64_t c = 0;
+  double t = 0;
+  HOST_port_reset(FALSE);
+  CNC_init(NULL, NULL, NULL, NULL, NULL);
+  for (i = 0; i < AXES_COUNT; i++) {
+    CNC_set_config_specific(COMM_PROTOCOL_CONFIG_MAX_X_FREQ + i, 20000);
+    CNC_set_config_specific(COMM_PROTOCOL_CONFIG_ACC_X + i, 20000);
+    CNC_set_config_specific(COMM_PROTOCOL_CONFIG_START_X_FREQ + i, 200);
+  }
+  CNC_set_config_specific(COMM_PROTOCOL_CONFIG_JUNCTION_DEV, 20);
+  // engine is not run, pipe fills up and is flushed
+  CNC_set_enabled(TRUE);
+  for (i = 0; i < motions; i++) {
+    s32_t steps[AXES_COUNT] = {0};
+    u32_t freq[AXES_COUNT] = {0};
+    double ang = 2 * M_PI * (i % segs) / segs;
+    s32_t x = (s32_t)(4000 * cos(ang)), y = (s32_t)(4000 * sin(ang));
+    steps[0] = x - px;
+    steps[1] = y - py;
+    px = x;
+    py = y;
+    freq[0] = (u32_t)ABS(steps[0]) << CNC_FP_DECIMALS;
+    freq[1] = (u32_t)ABS(steps[1]) << CNC_FP_DECIMALS;
+    if (CNC_is_latch_free() == FALSE) {
+      CNC_pipeline_flush();
+    }
+    double t0 = now();
+    u64_t c0 = BENCH_CYCLES();
+    s32_t res = CNC_latch(steps, freq, FALSE);
+    c += BENCH_CYCLES() - c0;
+    t += now() - t0;
+    if (res < 0) {
+      printf("latch error %i\n", res);
+      exit(1);
+    }
+  }
+  printf("%.0f motions/s %.0f cycles/motion\n", motions / t, (double)c / motions);
+}
+
+int main(int argc, char **argv) {
+  if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+    bench(argc > 2 ? atoi(argv[2]) : 1000000);
+    return 0;
+  }
+  test_sqrt();
+  test_motion();
+  test_junction();
+  test_profile();
+  printf("%u checks, %u failed\n", checks, failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,233 @@
+/*
+ * test_steps.c
+ *
+ * Step accounting tests of the cnc engine against the mock port: whatever
+ * stops, overwrites or drops the current motion, the machine position must
+ * count every step pulse the motors see, or none of a backlash take up.
+ *
+ * Each case is interrupted at a range of ticks so the step pins are caught
+ * in all phases of their pulses.
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: agent
+ */
+
+#include "cnc_control.h"
+#include "comm_proto_cnc.h"
+#include <stdio.h>
+
+// interruptions per case, ticks from first interruption to next
+#define STEPS_RUNS          40
+#define STEPS_RUN_TICKS     37
+// longest wait for engine, in ms
+#define STEPS_TIMEOUT       (60*1000)
+
+static u32_t failures;
+static u32_t checks;
+static u32_t loaded;
+
+#define CHECK_EQ(x, y) check_eq(__LINE__, #x, (s64_t)(x), (s64_t)(y))
+#define CHECK(x) check_eq(__LINE__, #x, (x) ? 1 : 0, 1)
+
+static void check_eq(int line, const char *what, s64_t x, s64_t y) {
+  checks++;
+  if (x != y) {
+    printf("line %i: %s is %lli, expected %lli\n", line, what, (long long)x, (long long)y);
+    failures++;
+  }
+}
+
+static void pipe_cb(u32_t id) {
+  loaded = TRUE;
+}
+
+static void start() {
+  HOST_port_reset(FALSE);
+  CNC_init(NULL, pipe_cb, NULL, NULL, NULL);
+  CNC_set_enabled(TRUE);
+  CNC_pipeline_enable(TRUE);
+  loaded = FALSE;
+}
+
+// runs engine for given ticks, feeding pipe like the comm task
+static void run(u32_t ticks) {
+  HOST_run(ticks);
+  if (loaded) {
+    loaded = FALSE;
+    CNC_pipeline_feed();
+  }
+}
+
+static void wait() {
+  u32_t ms = 0;
+  for (;;) {
+    u32_t sr = CNC_get_status();
+    if ((sr & (1<<CNC_STATUS_BIT_MOVEMENT_STILL)) &&
+        (sr & (1<<CNC_STATUS_BIT_PIPE_EMPTY)) && CNC_is_latch_free()) {
+      return;
+    }
+    if (++ms > STEPS_TIMEOUT) {
+      printf("wait timeout\n");
+      failures++;
+      return;
+    }
+    run(CNC_TIMER_FREQ/1000);
+  }
+}
+
+static void latch(s32_t x, s32_t y, s32_t z, u32_t freq) {
+  s32_t steps[AXES_COUNT] = {x, y, z};
+  u32_t f[AXES_COUNT] = {0};
+  int a;
+  for (a = 0; a < AXES_COUNT; a++) {
+    f[a] = (u32_t)(((u64_t)ABS(steps[a]) * freq << CNC_FP_DECIMALS) /
+        MAX(1, MAX(ABS(x), MAX(ABS(y), ABS(z)))));
+  }
+  CHECK((s32_t)CNC_latch(steps, f, FALSE) >= 0);
+}
+
+static void imm(s32_t x, u32_t fx, s32_t y, u32_t fy) {
+  s32_t steps[AXES_COUNT] = {x, y};
+  u32_t freq[AXES_COUNT] = {fx << CNC_FP_DECIMALS, fy << CNC_FP_DECIMALS};
+  CNC_set_imm(steps, freq);
+}
+
+// returns motor position less machine position of axis
+static s32_t lag(int a) {
+  s32_t motor[AXES_COUNT], pos[AXES_COUNT];
+  HOST_port_motor(motor);
+  CNC_get_machine_pos(pos);
+  return motor[a] - pos[a];
+}
+
+static s32_t machine_pos(int a) {
+  s32_t pos[AXES_COUNT];
+  CNC_get_machine_pos(pos);
+  return pos[a];
+}
+
+static void check_motors(int line) {
+  int a;
+  for (a = 0; a < AXES_COUNT; a++) {
+    check_eq(line, "motor less machine position", lag(a), 0);
+  }
+}
+#define CHECK_MOTORS() check_motors(__LINE__)
+
+#ifndef CONFIG_CNC_DMA_WAVE
+// probe contact decelerates and drops what is left of motion
+static void test_probe(u32_t t) {
+  start();
+  CNC_set_probe(TRUE);
+  latch(2000, -1500, 300, 3000);
+  run(t);
+  CNC_probe_irq();
+  wait();
+  CHECK_MOTORS();
+  CHECK_EQ(CNC_get_probe_status(), CNC_PROBE_CONTACT);
+}
+#endif
+
+// immediate motions overwriting each other, and stopped at once
+static void test_imm(u32_t t) {
+  start();
+  imm(1000, 3000, -700, 1234);
+  run(t);
+  imm(-500, 2000, 300, 777);
+  run(t / 2);
+  imm(0, 0, 0, 0);
+  run(t / 3);
+  CHECK_MOTORS();
+  // pulses caught by the stop complete with next motion
+  imm(100, 3000, 100, 3000);
+  wait();
+  CHECK_MOTORS();
+}
+
+// reset stops current motion and flushes pipe
+static void test_reset(u32_t t) {
+  start();
+  latch(3000, 1000, 0, 3000);
+  latch(-1000, 2000, 500, 2500);
+  run(t);
+  CNC_reset();
+  run(CNC_TIMER_FREQ/100);
+  CHECK_MOTORS();
+}
+
+// feed hold, flush and release
+static void test_hold(u32_t t) {
+  start();
+  latch(1000, 1000, 0, 3000);
+  latch(-500, 1000, 0, 3000);
+  latch(-500, -2000, 0, 3000);
+  run(t);
+  CNC_feed_hold(TRUE);
+  run(CNC_TIMER_FREQ/2);
+  CNC_pipeline_flush();
+  CNC_feed_hold(FALSE);
+  wait();
+  CHECK_MOTORS();
+}
+
+// backlash take up of a reversal overwritten by an immediate motion
+static void test_take_up_imm(u32_t t) {
+  s32_t l0, l;
+  start();
+  CNC_set_config_specific(COMM_PROTOCOL_CONFIG_BACKLASH | 1, 50);
+  CNC_set_config_specific(COMM_PROTOCOL_CONFIG_BACKLASH_FREQ | 1, 1000);
+  latch(400, 0, 0, 2000);
+  wait();
+  l0 = lag(0);
+  latch(-400, 0, 0, 2000);
+  // into the 50 ms of take up
+  run(CNC_TIMER_FREQ/100 + t);
+  imm(-300, 2000, 0, 0);
+  // steps of the immediate motion move the machine, take up steps do not,
+  // the motion at pipe head runs after without a take up
+  wait();
+  CHECK_EQ(machine_pos(0), -300);
+  l = lag(0);
+  CHECK(l <= l0 && l > l0 - 50);
+}
+
+// backlash take up dropped with the flushed motion at pipe head
+static void test_take_up_flush(u32_t t) {
+  s32_t l0, l;
+  start();
+  CNC_set_config_specific(COMM_PROTOCOL_CONFIG_BACKLASH | 1, 50);
+  CNC_set_config_specific(COMM_PROTOCOL_CONFIG_BACKLASH_FREQ | 1, 1000);
+  latch(400, 0, 0, 2000);
+  wait();
+  l0 = lag(0);
+  latch(-400, 0, 0, 2000);
+  run(CNC_TIMER_FREQ/100 + t);
+  CNC_pipeline_flush();
+  // a take up pulse caught low rises at next engine run
+  run(CNC_TIMER_FREQ/1000);
+  wait();
+  CHECK_EQ(machine_pos(0), 400);
+  l = lag(0);
+  CHECK(l <= l0 && l > l0 - 50);
+  latch(-100, 0, 0, 2000);
+  wait();
+  CHECK_EQ(machine_pos(0), 300);
+  CHECK_EQ(lag(0), l);
+}
+
+int main(int argc, char **argv) {
+  u32_t i;
+  for (i = 0; i < STEPS_RUNS; i++) {
+    u32_t t = CNC_TIMER_FREQ/50 + i * STEPS_RUN_TICKS;
+#ifndef CONFIG_CNC_DMA_WAVE
+    test_probe(t);
+#endif
+    test_imm(t);
+    test_reset(t);
+    test_hold(t);
+    test_take_up_imm(i * STEPS_RUN_TICKS);
+    test_take_up_flush(i * STEPS_RUN_TICKS);
+  }
+  printf("%u checks, %u failed\n", checks, failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,124 @@
+/*
+ * test_timer_profile.c
+ *
+ * Unit tests of the system timer irq cycle statistics of timer_profile.c,
+ * built with CONFIG_TIMER_PROFILE.
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: agent
+ */
+
+#include "timer_profile.h"
+#include <stdio.h>
+
+static u32_t failures;
+static u32_t checks;
+
+#define CHECK_EQ(x, y) check_eq(__LINE__, #x, (u64_t)(x), (u64_t)(y))
+
+static void check_eq(int line, const char *what, u64_t x, u64_t y) {
+  checks++;
+  if (x != y) {
+    printf("line %i: %s is %llu, expected %llu\n", line, what,
+        (unsigned long long)x, (unsigned long long)y);
+    failures++;
+  }
+}
+
+static void test_stat() {
+  TPROF_stat_t s;
+  TPROF_init(1000);
+
+  // no samples, min stays above any sample and average is zero
+  TPROF_get_stat(TPROF_CNC, &s);
+  CHECK_EQ(s.count, 0);
+  CHECK_EQ(s.min, 0xffffffff);
+  CHECK_EQ(s.max, 0);
+  CHECK_EQ(TPROF_avg(&s), 0);
+
+  TPROF_add(TPROF_CNC, 300);
+  TPROF_add(TPROF_CNC, 100);
+  TPROF_add(TPROF_CNC, 201);
+  TPROF_get_stat(TPROF_CNC, &s);
+  CHECK_EQ(s.count, 3);
+  CHECK_EQ(s.min, 100);
+  CHECK_EQ(s.max, 300);
+  CHECK_EQ(s.sum, 601);
+  CHECK_EQ(TPROF_avg(&s), 200);
+
+  // stages are kept apart
+  TPROF_get_stat(TPROF_SYS, &s);
+  CHECK_EQ(s.count, 0);
+
+  // sum does not wrap at 32 bits
+  TPROF_add(TPROF_OS, 0xffffffff);
+  TPROF_add(TPROF_OS, 0xffffffff);
+  TPROF_get_stat(TPROF_OS, &s);
+  CHECK_EQ(s.sum, 2 * (u64_t)0xffffffff);
+  CHECK_EQ(TPROF_avg(&s), 0xffffffff);
+
+  TPROF_clear();
+  TPROF_get_stat(TPROF_CNC, &s);
+  CHECK_EQ(s.count, 0);
+  CHECK_EQ(s.sum, 0);
+  CHECK_EQ(s.min, 0xffffffff);
+}
+
+static void test_hist() {
+  TPROF_hist_t h;
+  TPROF_stat_t s;
+  TPROF_init(800);
+
+  // within budget, counted in isr stage only
+  TPROF_add_isr(100);
+  TPROF_add_isr(800);
+  TPROF_get_hist(&h);
+  CHECK_EQ(h.budget, 800);
+  CHECK_EQ(h.overruns, 0);
+  TPROF_get_stat(TPROF_ISR, &s);
+  CHECK_EQ(s.count, 2);
+  CHECK_EQ(s.max, 800);
+
+  // bins span budget/TPROF_HIST_BINS = 100 cycles of excess each
+  TPROF_add_isr(801);
+  TPROF_add_isr(899);
+  TPROF_add_isr(900);
+  TPROF_add_isr(1550);
+  TPROF_add_isr(1599);
+  // twice the budget and beyond go to last bin
+  TPROF_add_isr(1600);
+  TPROF_add_isr(0xffffffff);
+  TPROF_get_hist(&h);
+  CHECK_EQ(h.overruns, 7);
+  CHECK_EQ(h.bins[0], 2);
+  CHECK_EQ(h.bins[1], 1);
+  CHECK_EQ(h.bins[7], 4);
+  CHECK_EQ(h.bins[2] + h.bins[3] + h.bins[4] + h.bins[5] + h.bins[6], 0);
+
+  // clear keeps budget
+  TPROF_clear();
+  TPROF_get_hist(&h);
+  CHECK_EQ(h.budget, 800);
+  CHECK_EQ(h.overruns, 0);
+  CHECK_EQ(h.bins[7], 0);
+
+  // no budget, no overruns
+  TPROF_init(0);
+  TPROF_add_isr(5000);
+  TPROF_get_hist(&h);
+  CHECK_EQ(h.overruns, 0);
+}
+
+static void test_name() {
+  CHECK_EQ(strcmp(TPROF_name(TPROF_CNC), "cnc"), 0);
+  CHECK_EQ(strcmp(TPROF_name(TPROF_ISR), "isr"), 0);
+  CHECK_EQ(strcmp(TPROF_name(TPROF_STAGES), "?"), 0);
+}
+
+int main(int argc, char **argv) {
+  test_stat();
+  test_hist();
+  test_name();
+  printf("%u checks, %u failed\n", checks, failures);
+  return failures ? 1 : 0;
+}
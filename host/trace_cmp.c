@@ -0,0 +1,123 @@
+/*
+ * trace_cmp.c
+ *
+ * Compares two cnc_seq traces pin by pin. Both must have the same number of
+ * edges on each pin and the same "#" result lines. The interval from each
+ * edge of a pin to its next edge may differ at most max_dev ticks between
+ * a and b. Largest deviation of interval and of edge tick are printed.
+ *
+ * Usage: trace_cmp <a> <b> [max_dev]
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: agent
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PINS          16
+
+typedef struct {
+  unsigned int *tick;
+  unsigned int count;
+  unsigned int size;
+} edges_t;
+
+typedef struct {
+  edges_t pin[PINS];
+  char **results;
+  unsigned int result_count;
+} trace_t;
+
+static void add_edge(edges_t *e, unsigned int tick) {
+  if (e->count == e->size) {
+    e->size = e->size ? e->size * 2 : 256;
+    e->tick = realloc(e->tick, e->size * sizeof(unsigned int));
+  }
+  e->tick[e->count++] = tick;
+}
+
+static int load(const char *name, trace_t *t) {
+  char buf[256];
+  unsigned int odr = 0;
+  FILE *f = fopen(name, "r");
+  if (f == NULL) {
+    perror(name);
+    return -1;
+  }
+  memset(t, 0, sizeof(*t));
+  while (fgets(buf, sizeof(buf), f)) {
+    unsigned int tick, bsrr, next, p;
+    if (buf[0] == '#') {
+      // tick count at end differs with engine schedule
+      if (strncmp(buf, "# end", 5) == 0) {
+        continue;
+      }
+      t->results = realloc(t->results, (t->result_count + 1) * sizeof(char *));
+      t->results[t->result_count++] = strdup(buf);
+      continue;
+    }
+    if (sscanf(buf, "%u %x", &tick, &bsrr) != 2) {
+      continue;
+    }
+    next = (odr & ~(bsrr >> 16)) | (bsrr & 0xffff);
+    for (p = 0; p < PINS; p++) {
+      if ((next ^ odr) & (1<<p)) {
+        add_edge(&t->pin[p], tick);
+      }
+    }
+    odr = next;
+  }
+  fclose(f);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  trace_t a, b;
+  unsigned int max_dev = argc > 3 ? atoi(argv[3]) : 0;
+  unsigned int dev = 0, jitter = 0, edges = 0, p, i;
+  if (argc < 3) {
+    fprintf(stderr, "usage: trace_cmp <a> <b> [max_dev]\n");
+    return 2;
+  }
+  if (load(argv[1], &a) || load(argv[2], &b)) {
+    return 1;
+  }
+  if (a.result_count != b.result_count) {
+    printf("results differ\n");
+    return 1;
+  }
+  for (i = 0; i < a.result_count; i++) {
+    if (strcmp(a.results[i], b.results[i])) {
+      printf("results differ:\n%s%s", a.results[i], b.results[i]);
+      return 1;
+    }
+  }
+  for (p = 0; p < PINS; p++) {
+    if (a.pin[p].count != b.pin[p].count) {
+      printf("pin %u has %u edges against %u\n", p, a.pin[p].count, b.pin[p].count);
+      return 1;
+    }
+    for (i = 0; i < a.pin[p].count; i++) {
+      unsigned int ta = a.pin[p].tick[i];
+      unsigned int tb = b.pin[p].tick[i];
+      unsigned int d = ta > tb ? ta - tb : tb - ta;
+      if (d > dev) {
+        dev = d;
+      }
+      if (i > 0) {
+        unsigned int ia = ta - a.pin[p].tick[i - 1];
+        unsigned int ib = tb - b.pin[p].tick[i - 1];
+        d = ia > ib ? ia - ib : ib - ia;
+        if (d > jitter) {
+          jitter = d;
+        }
+      }
+    }
+    edges += a.pin[p].count;
+  }
+  printf("%u edges, max interval deviation %u ticks, max edge deviation %u ticks\n",
+      edges, jitter, dev);
+  return jitter > max_dev ? 1 : 0;
+}
@@ -0,0 +1,30 @@
+/*
+ * types.h
+ *
+ * Host stand in for the generic types header.
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: agent
+ */
+
+#ifndef TYPES_H_
+#define TYPES_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef int64_t s64_t;
+typedef uint64_t u64_t;
+typedef int32_t s32_t;
+typedef uint32_t u32_t;
+typedef int16_t s16_t;
+typedef uint16_t u16_t;
+typedef int8_t s8_t;
+typedef uint8_t u8_t;
+
+typedef u8_t bool;
+
+#define TRUE  1
+#define FALSE 0
+
+#endif /* TYPES_H_ */
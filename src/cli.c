@@ -21,6 +21,7 @@
 #include "spi_driver.h"
 #include "nvstorage.h"
 #include "os.h"
+#include "timer.h"
 #ifdef CONFIG_ETHSPI
 #include "enc28j60.h"
 #include "enc28j60_spi_eth.h"
@@ -68,12 +69,19 @@ static int f_cnc_move(int x, int y, int z);
 static int f_cnc_srmask(u32_t sr_mask);
 static int f_cnc_xyz(int sx, int fx, int sy, int fy, int sz, int fz, int r);
 static int f_cnc_xyz_imm(int sx, int fx, int sy, int fy, int sz, int fz);
+static int f_cnc_arc(int plane, int c0, int c1, int e0, int e1, int ccw, int feed);
 static int f_cnc_pause(int pause);
+static int f_cnc_ovr(int percent);
+static int f_cnc_hold(int hold);
+static int f_cnc_probe(int enable);
+static int f_cnc_home(int axes);
+static int f_cnc_limit(int axis, int min, int max);
 static int f_cnc_pon();
 static int f_cnc_poff();
 static int f_cnc_pflush();
 static int f_cnc_sr_recurrence(int delta);
 static int f_cnc_pos_recurrence(int delta);
+static int f_cnc_id_recurrence(int delta);
 static int f_cnc_io();
 static int f_cnc_err_on(int);
 static int f_cnc_err_off(int);
@@ -1260,6 +1268,13 @@ static cmd c_tbl[] = {
         "step - number of stepper motor steps - integer, sign gives direction\n"\
         "freq - stepper frequency - hexadecimal, Q18.14\n"
     },
+    {.name = "cnc_arc",  .fn = (func)f_cnc_arc,
+        .help = "Puts an arc into cnc latch register\n"\
+        "cnc_arc <plane> <centre0> <centre1> <end0> <end1> <ccw> <feed>\n"\
+        "plane - 0:XY 1:XZ 2:YZ\n"\
+        "centre, end - steps relative to current position, zero end for full circle\n"\
+        "feed - path frequency - hexadecimal, Q18.14\n"
+    },
     {.name = "cnc_xyz_imm",  .fn = (func)f_cnc_xyz_imm,
         .help = "Puts a movement into cnc working register\n"\
         "cnc_xyz_imm <stepsX> <freqX> <stepsY> <freqY> <stepsZ> <freqZ>\n"\
@@ -1271,6 +1286,30 @@ static cmd c_tbl[] = {
         .help = "Puts a pause into cnc latch register\n"\
         "cnc_pause <pause in ms>\n"
     },
+    {.name = "cnc_ovr",  .fn = (func)f_cnc_ovr,
+        .help = "Sets or prints feed override in percent\n"\
+        "cnc_ovr (<percent>)\n"\
+        "ex: cnc_ovr 80\n"
+    },
+    {.name = "cnc_hold",  .fn = (func)f_cnc_hold,
+        .help = "Feed hold, decelerates to a stop and resumes on release\n"\
+        "cnc_hold <1|0>\n"
+    },
+    {.name = "cnc_probe",  .fn = (func)f_cnc_probe,
+        .help = "Arms probe or prints probe status and contact position\n"\
+        "cnc_probe (<1|0>)\n"
+    },
+    {.name = "cnc_home",  .fn = (func)f_cnc_home,
+        .help = "Homes axes on limit switches\n"\
+        "cnc_home <axes> - b0:x b1:y b2:z b3:a\n"\
+        "ex: cnc_home 0b111\n"
+    },
+    {.name = "cnc_limit",  .fn = (func)f_cnc_limit,
+        .help = "Sets soft limits of an axis in machine steps, or axes having them enforced\n"\
+        "cnc_limit <axis> <min> <max> - axis 0:x 1:y 2:z 3:a\n"\
+        "cnc_limit <axes> - b0:x b1:y b2:z b3:a\n"\
+        "ex: cnc_limit 2 -40000 0\n"
+    },
     {.name = "cnc_pon",  .fn = (func)f_cnc_pon,
         .help = "Enable cnc pipeline\n"
     },
@@ -1296,6 +1335,10 @@ static cmd c_tbl[] = {
         "b5 - pipeline empty\n"\
         "b6 - pipeline full\n"\
         "b7 - latch reg full\n"\
+        "b16 - feed hold\n"\
+        "b17 - feed held\n"\
+        "b18 - homing\n"\
+        "b19 - homed\n"\
         "ex: cnc_srmask 0b10100011\n"
     },
     {.name = "cnc_sr_recurrence", .fn = (func)f_cnc_sr_recurrence,
@@ -1308,6 +1351,11 @@ static cmd c_tbl[] = {
         "cnc_pos_recurrence <time_in_ms> - if <time_in_ms> is zero, reporting is disabled\n" \
         "ex: cnc_pos_recurrence 1000\n"
     },
+    {.name = "cnc_id_recurrence", .fn = (func)f_cnc_id_recurrence,
+        .help = "Sets max delay of motion id reports in ms\n" \
+        "cnc_id_recurrence <time_in_ms> - 1 to 1000, default 10\n" \
+        "ex: cnc_id_recurrence 10\n"
+    },
     {.name = "cnc_io",  .fn = (func)f_cnc_io,
         .help = "Set individual pin state of cnc\n"\
         "cnc_io ((<pin>)* <1|0|flip <times> <hz>>)*\n" \
@@ -1325,6 +1373,14 @@ static cmd c_tbl[] = {
         "cnc_err_on <error>\n" \
         "ex: cnc_err_on 0xff\n"
     },
+#ifdef CONFIG_CNC_TRACE
+    {.name = "cnc_trace",  .fn = (func)CNC_trace_dump,
+        .help = "Dumps and empties recorded cnc port changes as <tick> <bsrr>\n"
+    },
+    {.name = "cnc_trace_clear",  .fn = (func)CNC_trace_clear,
+        .help = "Empties recorded cnc port changes and restarts tick count\n"
+    },
+#endif
 #endif // CONFIG_CNC
 
     {.name = "comm_send",  .fn = (func)f_comm_send,
@@ -1357,6 +1413,14 @@ static cmd c_tbl[] = {
     {.name = "dump_trace",  .fn = (func)f_dump_trace,
             .help = "Dumps system trace\n"
     },
+#ifdef CONFIG_TIMER_PROFILE
+    {.name = "timer_prof",  .fn = (func)TIMER_profile_dump,
+            .help = "Dumps cpu cycles spent per stage of system timer irq\n"
+    },
+    {.name = "timer_prof_clear",  .fn = (func)TIMER_profile_clear,
+            .help = "Resets system timer irq cycle statistics\n"
+    },
+#endif
     {.name = "time",  .fn = (func)f_time,
             .help = "Prints or sets time\n"\
                 "time or time <day> <hour> <minute> <second> <millisecond>\n"
@@ -1712,6 +1776,21 @@ static int f_cnc_xyz(int sx, int fx, int sy, int fy, int sz, int fz, int r) {
   return 0;
 }
 
+static int f_cnc_arc(int plane, int c0, int c1, int e0, int e1, int ccw, int feed) {
+  if (_argc != 7) {
+    return -1;
+  }
+  u32_t res = CNC_latch_arc(plane, c0, c1, e0, e1, ccw, feed);
+  if (res == CNC_ERR_LATCH_BUSY) {
+    print("CNC_latch failed, latch busy\n");
+  } else if (res == CNC_ERR_LATCH_ARG) {
+    print("CNC_latch failed, bad arc\n");
+  } else if (res == CNC_ERR_LATCH_LIMIT) {
+    print("CNC_latch failed, outside soft limits\n");
+  }
+  return 0;
+}
+
 static int f_cnc_xyz_imm(int sx, int fx, int sy, int fy, int sz, int fz) {
   if (_argc != 6) {
     return -1;
@@ -1731,6 +1810,66 @@ static int f_cnc_pause(int pause) {
   return 0;
 }
 
+static int f_cnc_ovr(int percent) {
+  if (_argc == 0) {
+    print("feed override: %i%%\n", CNC_get_feed_override());
+  } else if (_argc == 1) {
+    print("feed override: %i%%\n", CNC_set_feed_override(percent));
+  } else {
+    return -1;
+  }
+  return 0;
+}
+
+static int f_cnc_hold(int hold) {
+  if (_argc != 1) {
+    return -1;
+  }
+  CNC_feed_hold(hold);
+  return 0;
+}
+
+static int f_cnc_probe(int enable) {
+  if (_argc == 0) {
+    s32_t pos[AXES_COUNT];
+    CNC_get_probe_pos(pos);
+    u32_t status = CNC_get_probe_status();
+    print("probe: %s\n", status == CNC_PROBE_CONTACT ? "contact" :
+        (status == CNC_PROBE_NOCONTACT ? "armed" : "disarmed"));
+    if (status == CNC_PROBE_CONTACT) {
+      print("x:%i y:%i z:%i\n", pos[X_AXIS], pos[Y_AXIS], pos[Z_AXIS]);
+    }
+  } else if (_argc == 1) {
+    CNC_set_probe(enable);
+  } else {
+    return -1;
+  }
+  return 0;
+}
+
+static int f_cnc_home(int axes) {
+  if (_argc != 1) {
+    return -1;
+  }
+  if (!CNC_home(axes)) {
+    print("CNC_home failed, already homing\n");
+  }
+  return 0;
+}
+
+static int f_cnc_limit(int axis, int min, int max) {
+  if (_argc == 3 && axis >= 0 && axis < AXES_COUNT) {
+    CNC_set_config_specific(COMM_PROTOCOL_CONFIG_SOFT_MIN | (axis + 1), min);
+    CNC_set_config_specific(COMM_PROTOCOL_CONFIG_SOFT_MAX | (axis + 1), max);
+  } else if (_argc == 1) {
+    CNC_set_config_specific(COMM_PROTOCOL_CONFIG_SOFT_LIMITS, axis);
+  } else {
+    return -1;
+  }
+  CONFIG_CNC_limits_store();
+  return 0;
+}
+
 static int f_cnc_pon() {
   CNC_pipeline_enable(TRUE);
   return 0;
@@ -1765,6 +1904,10 @@ static int f_cnc_status() {
   print("b5 pipeline empty : %s\n", (sr & (1<<CNC_STATUS_BIT_PIPE_EMPTY)) ? "on" : "off");
   print("b6 pipeline full  : %s\n", (sr & (1<<CNC_STATUS_BIT_PIPE_FULL)) ? "on" : "off");
   print("b7 latch reg full : %s\n", (sr & (1<<CNC_STATUS_BIT_LATCH_FULL)) ? "on" : "off");
+  print("b16 feed hold     : %s\n", (sr & (1<<CNC_STATUS_BIT_FEED_HOLD)) ? "on" : "off");
+  print("b17 feed held     : %s\n", (sr & (1<<CNC_STATUS_BIT_FEED_HELD)) ? "on" : "off");
+  print("b18 homing        : %s\n", (sr & (1<<CNC_STATUS_BIT_HOMING)) ? "on" : "off");
+  print("b19 homed         : %s\n", (sr & (1<<CNC_STATUS_BIT_HOMED)) ? "on" : "off");
   return 0;
 }
 
@@ -1788,6 +1931,16 @@ static int f_cnc_pos_recurrence(int delta) {
   return 0;
 }
 
+static int f_cnc_id_recurrence(int delta) {
+  if (_argc != 1) {
+    return -1;
+  } else {
+    COMM_CNC_set_id_timer_recurrence(delta);
+    COMM_CNC_apply_id_timer_recurrence();
+  }
+  return 0;
+}
+
 static int f_cnc_io() {
   if (_argc == 0) {
     u32_t v = CNC_GPIO_DEF_READ();
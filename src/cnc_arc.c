@@ -0,0 +1,182 @@
+/*
+ * cnc_arc.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: agent
+ */
+
+#include "cnc_arc.h"
+#include "cnc_planner.h"
+
+#ifdef CONFIG_CNC
+
+#define CORDIC_ITERATIONS   (30)
+/* CORDIC gain compensation, 0.607252935 in Q30 */
+#define CORDIC_K            (652032874)
+/* Binary angle of one radian in Q16 */
+#define ARC_RADIAN_Q16      (683565276ULL)
+/* Guard input bits of CORDIC vectoring */
+#define ARC_POLAR_GUARD     (16)
+
+/* atan(2^-i) as binary angles */
+static const u32_t cordic_atan[CORDIC_ITERATIONS] = {
+  536870912, 316933406, 167458907, 85004756, 42667331, 21354465, 10679838, 5340245,
+  2670163, 1335087, 667544, 333772, 166886, 83443, 41722, 20861,
+  10430, 5215, 2608, 1304, 652, 326, 163, 81,
+  41, 20, 10, 5, 3, 1
+};
+
+void CNC_ARC_sincos(u32_t angle, s32_t *cos, s32_t *sin) {
+  s32_t x = CORDIC_K;
+  s32_t y = 0;
+  s32_t z = (s32_t)angle;
+  bool flip = FALSE;
+  int i;
+  // rotation converges within +-90 degrees, turn other half around
+  if (z > 0x40000000 || z < -0x40000000) {
+    z = (s32_t)(angle + 0x80000000);
+    flip = TRUE;
+  }
+  for (i = 0; i < CORDIC_ITERATIONS; i++) {
+    s32_t dx = x >> i;
+    s32_t dy = y >> i;
+    if (z >= 0) {
+      x -= dy;
+      y += dx;
+      z -= cordic_atan[i];
+    } else {
+      x += dy;
+      y -= dx;
+      z += cordic_atan[i];
+    }
+  }
+  *cos = flip ? -x : x;
+  *sin = flip ? -y : y;
+}
+
+u32_t CNC_ARC_polar(s32_t x, s32_t y, s32_t *len) {
+  s64_t vx = (s64_t)x << ARC_POLAR_GUARD;
+  s64_t vy = (s64_t)y << ARC_POLAR_GUARD;
+  u32_t z = 0;
+  int i;
+  // vectoring converges in right half plane
+  if (vx < 0) {
+    vx = -vx;
+    vy = -vy;
+    z = 0x80000000;
+  }
+  for (i = 0; i < CORDIC_ITERATIONS; i++) {
+    s64_t dx = vx >> i;
+    s64_t dy = vy >> i;
+    if (vy > 0) {
+      vx += dy;
+      vy -= dx;
+      z += cordic_atan[i];
+    } else {
+      vx -= dy;
+      vy += dx;
+      z -= cordic_atan[i];
+    }
+  }
+  // drop guard bits partly before gain compensation to stay within 64 bits
+  vx = ((vx >> (ARC_POLAR_GUARD / 2)) * CORDIC_K) >> 30;
+  *len = (s32_t)((vx + (1 << (ARC_POLAR_GUARD / 2 - 1))) >> (ARC_POLAR_GUARD / 2));
+  return z;
+}
+
+// rounds Q30 product of radius r + r_frac/2^16 to integer
+static s32_t arc_mul_q30(s32_t r, s32_t r_frac, s32_t f) {
+  return (s32_t)(((s64_t)r * f + (((s64_t)r_frac * f) >> 16) + (1 << 29)) >> 30);
+}
+
+void CNC_ARC_init(CNC_Arc_t *arc, s32_t c0, s32_t c1, s32_t e0, s32_t e1,
+    bool ccw, u32_t tolerance) {
+  u32_t end_angle;
+  arc->c[0] = c0;
+  arc->c[1] = c1;
+  arc->end[0] = e0;
+  arc->end[1] = e1;
+  arc->ccw = ccw;
+  arc->seg = 0;
+  arc->p[0] = 0;
+  arc->p[1] = 0;
+  arc->angle = CNC_ARC_polar(-c0, -c1, &arc->r_start);
+  end_angle = CNC_ARC_polar(e0 - c0, e1 - c1, &arc->r_end);
+  arc->sweep = (u32_t)(ccw ? end_angle - arc->angle : arc->angle - end_angle);
+  if (e0 == 0 && e1 == 0) {
+    arc->sweep = CNC_ARC_TURN;
+  }
+
+  // chord error r * (1 - cos(a/2)) is about r * a^2 / 8
+  u32_t r = MAX(1, MAX(arc->r_start, arc->r_end));
+  u32_t seg_rad_q16 = CNC_PLAN_sqrt(((u64_t)8 * MAX(1, tolerance) << 32) / ((u64_t)r * 1000));
+  u64_t seg_angle = MAX(1, ((u64_t)seg_rad_q16 * ARC_RADIAN_Q16) >> 16);
+  arc->segs = (u32_t)MAX(1, (arc->sweep + seg_angle - 1) / seg_angle);
+}
+
+bool CNC_ARC_next(CNC_Arc_t *arc, s32_t *d0, s32_t *d1) {
+  while (arc->seg < arc->segs) {
+    s32_t p0, p1;
+    arc->seg++;
+    if (arc->seg == arc->segs) {
+      p0 = arc->end[0];
+      p1 = arc->end[1];
+    } else {
+      // each point is calculated from start, no accumulated error
+      u32_t da = (u32_t)((arc->sweep * arc->seg) / arc->segs);
+      u32_t a = arc->ccw ? arc->angle + da : arc->angle - da;
+      // spiral radius keeps its fraction, truncating it would bend the
+      // path up to a step off the arc
+      s64_t dr = (s64_t)(arc->r_end - arc->r_start) * arc->seg;
+      s32_t r = arc->r_start + (s32_t)(dr / arc->segs);
+      s32_t r_frac = (s32_t)(((dr % arc->segs) << 16) / arc->segs);
+      s32_t cos, sin;
+      CNC_ARC_sincos(a, &cos, &sin);
+      p0 = arc->c[0] + arc_mul_q30(r, r_frac, cos);
+      p1 = arc->c[1] + arc_mul_q30(r, r_frac, sin);
+    }
+    *d0 = p0 - arc->p[0];
+    *d1 = p1 - arc->p[1];
+    arc->p[0] = p0;
+    arc->p[1] = p1;
+    if (*d0 != 0 || *d1 != 0) {
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+void CNC_ARC_bounds(const CNC_Arc_t *arc, s32_t *min, s32_t *max) {
+  s32_t r = MAX(arc->r_start, arc->r_end);
+  u32_t q;
+  int i;
+  for (i = 0; i < 2; i++) {
+    min[i] = MIN(0, arc->end[i]);
+    max[i] = MAX(0, arc->end[i]);
+    if (arc->r_start != arc->r_end) {
+      // spiral lies between both radii, it may bulge past its ends
+      s32_t s = arc->c[i] - (s32_t)(((s64_t)arc->c[i] * arc->r_end) / MAX(1, arc->r_start));
+      s32_t e = arc->c[i] +
+          (s32_t)(((s64_t)(arc->end[i] - arc->c[i]) * arc->r_start) / MAX(1, arc->r_end));
+      min[i] = MIN(min[i], MIN(s, e) - 1);
+      max[i] = MAX(max[i], MAX(s, e) + 1);
+    }
+  }
+  // extremes are where the arc crosses an axis direction seen from centre,
+  // a rounded point may lie a step beyond
+  for (q = 0; q < 4; q++) {
+    u32_t a = q << 30;
+    u32_t da = arc->ccw ? a - arc->angle : arc->angle - a;
+    if (da >= arc->sweep) {
+      continue;
+    }
+    i = q & 1;
+    if (q < 2) {
+      max[i] = MAX(max[i], arc->c[i] + r + 1);
+    } else {
+      min[i] = MIN(min[i], arc->c[i] - r - 1);
+    }
+  }
+}
+
+#endif // CONFIG_CNC
@@ -0,0 +1,82 @@
+/*
+ * cnc_arc.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: agent
+ */
+
+#ifndef CNC_ARC_H_
+#define CNC_ARC_H_
+
+#include "system.h"
+
+/**
+ * Fixed point arc segment generator. An arc lies in the plane of two axes
+ * and is given in steps relative to its start point. Segments are generated
+ * one at a time so an arc can be fed into the pipe as the pipe drains.
+ * Generator functions are pure and do not touch any hardware nor machine
+ * state.
+ */
+
+/* Arc planes, counter clockwise turns from first towards second axis */
+#define CNC_ARC_PLANE_XY      (0)
+#define CNC_ARC_PLANE_XZ      (1)
+#define CNC_ARC_PLANE_YZ      (2)
+
+/* Angles are binary, a full turn is 2^32 */
+#define CNC_ARC_TURN          ((u64_t)1 << 32)
+
+typedef struct CNC_Arc_s {
+  /* Centre relative to start */
+  s32_t c[2];
+  /* End relative to start */
+  s32_t end[2];
+  /* Radius at start and end, differing radii give a spiral */
+  s32_t r_start;
+  s32_t r_end;
+  /* Angle of start point seen from centre */
+  u32_t angle;
+  /* Swept angle, a full turn if start and end coincide */
+  u64_t sweep;
+  u8_t ccw;
+  /* Number of segments and segments generated so far */
+  u32_t segs;
+  u32_t seg;
+  /* Last generated point relative to start */
+  s32_t p[2];
+} CNC_Arc_t;
+
+/**
+ * Sets up generator for an arc from start point with centre at (c0, c1)
+ * and end at (e0, e1), relative to start. Segments are made short enough
+ * to keep chord error within tolerance, given in 1/1000 steps.
+ */
+void CNC_ARC_init(CNC_Arc_t *arc, s32_t c0, s32_t c1, s32_t e0, s32_t e1,
+    bool ccw, u32_t tolerance);
+
+/**
+ * Generates next segment of arc as steps along both plane axes. Returns
+ * FALSE when all segments are generated. The segments always add up to
+ * the arc end point.
+ */
+bool CNC_ARC_next(CNC_Arc_t *arc, s32_t *d0, s32_t *d1);
+
+/**
+ * Calculates bounding box of whole arc relative to start, lowest and
+ * highest step of both plane axes. The box may exceed the arc by a step
+ * of rounding, spirals are bounded by both radii at both ends and by the
+ * larger radius.
+ */
+void CNC_ARC_bounds(const CNC_Arc_t *arc, s32_t *min, s32_t *max);
+
+/**
+ * Calculates cosine and sine of a binary angle in Q30.
+ */
+void CNC_ARC_sincos(u32_t angle, s32_t *cos, s32_t *sin);
+
+/**
+ * Calculates binary angle and length of vector (x, y).
+ */
+u32_t CNC_ARC_polar(s32_t x, s32_t y, s32_t *len);
+
+#endif /* CNC_ARC_H_ */
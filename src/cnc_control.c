@@ -5,18 +5,104 @@
  *      Author: Peter
  */
 #include "cnc_control.h"
+#include "cnc_planner.h"
+#include "cnc_arc.h"
 #include "comm_proto_cnc.h"
 #include "miniutils.h"
 #include "led.h"
 
 #ifdef CONFIG_CNC
 
+#if (CNC_PIPE_CAPACITY & (CNC_PIPE_CAPACITY - 1)) != 0
+#error CNC_PIPE_CAPACITY must be a power of two
+#endif
+
+// index mask of pipe sequence numbers
+#define CNC_PIPE_MASK         (CNC_PIPE_CAPACITY - 1)
+// orders pipe slot contents against pipe sequence number updates
+#define CNC_PIPE_BARRIER()    __DMB()
+
+// step and dir pins of each axis
+static const u16_t axis_step_pin[AXES_COUNT] = {
+    CNC_GPIO_STEP_X, CNC_GPIO_STEP_Y, CNC_GPIO_STEP_Z,
+#if CNC_AXES > 3
+    CNC_GPIO_STEP_A,
+#endif
+};
+static const u16_t axis_dir_pin[AXES_COUNT] = {
+    CNC_GPIO_DIR_X, CNC_GPIO_DIR_Y, CNC_GPIO_DIR_Z,
+#if CNC_AXES > 3
+    CNC_GPIO_DIR_A,
+#endif
+};
+// limit switch pins of each axis
+static const u16_t axis_limit_pin[AXES_COUNT] = {
+    CNC_GPIO_LIMIT_X, CNC_GPIO_LIMIT_Y, CNC_GPIO_LIMIT_Z,
+#if CNC_AXES > 3
+    CNC_GPIO_LIMIT_A,
+#endif
+};
+// axes in homing order
+static const u8_t home_order[] = {
+    Z_AXIS, X_AXIS, Y_AXIS,
+#if CNC_AXES > 3
+    A_AXIS,
+#endif
+};
+// all step and dir pins driven by engine
+#if CNC_AXES > 3
+#define CNC_AXES_PINS         (CNC_GPIO_STEP_X | CNC_GPIO_DIR_X | CNC_GPIO_STEP_Y | CNC_GPIO_DIR_Y | \
+                               CNC_GPIO_STEP_Z | CNC_GPIO_DIR_Z | CNC_GPIO_STEP_A | CNC_GPIO_DIR_A)
+#else
+#define CNC_AXES_PINS         (CNC_GPIO_STEP_X | CNC_GPIO_DIR_X | CNC_GPIO_STEP_Y | CNC_GPIO_DIR_Y | \
+                               CNC_GPIO_STEP_Z | CNC_GPIO_DIR_Z)
+#endif
+
+// Q format of feed scale, 1.0 is no override
+#define CNC_FEED_Q            (28)
+#define CNC_FEED_ONE          ((u32_t)1 << CNC_FEED_Q)
+
+// reads a motion register written by timer from any context
+#define TIMER_REG(x)          (*(volatile u32_t *)&(x))
+
+/**
+ * Running motion registers. Per axis registers are kept in arrays, hot ones
+ * first, so the timer works on contiguous words it may keep in registers
+ * during an engine run. Only written by timer, or with timer held off.
+ */
+typedef struct {
+  u32_t id;
+  /* Axis timers, advanced by axis frequency each tick */
+  u32_t timer_counter[AXES_COUNT];
+  u32_t step_freq[AXES_COUNT];
+  u32_t step_freq_adj[AXES_COUNT];
+  /* Steps left of each axis */
+  u32_t step_count[AXES_COUNT];
+  /* Bresenham error terms of minor axes in coordinated motion */
+  u32_t bres_err[AXES_COUNT];
+  /* Total steps of axis in motion */
+  u32_t step_total[AXES_COUNT];
+  /* Steps rapid axis took accelerating, it decelerates over as many */
+  u32_t ramp_steps[AXES_COUNT];
+  /* Axis speed per path speed for planned motions, see cnc_planner.h */
+  u32_t step_factor[AXES_COUNT];
+  /* Axes moving in positive direction */
+  u32_t dir_axes;
+  u32_t pause;
+  u32_t rapid;
+  CNC_Profile_t profile;
+} CNC_Regs_t;
+
 /**
  * Machine state
  */
 static struct {
-  /* Status register */
-  volatile u8_t sr;
+  /* Status register, only written by timer on state transitions */
+  volatile u32_t sr;
+  /* Set when status register needs to be recalculated */
+  volatile u32_t sr_dirty;
+  /* Last status register seen by deferred status handling */
+  u32_t sr_reported;
   /* Status register report mask */
   volatile u32_t sr_mask;
   /* Status register error mask */
@@ -27,198 +113,819 @@ static struct {
   cnc_sr_callback sr_cb;
   cnc_pos_callback pos_cb;
   cnc_offs_callback offs_cb;
+  cnc_probe_callback probe_cb;
 
   CNC_Config_t config;
 
   /* Flag indicating if motor control is active, setting to 0 prohibits any motor activity */
   volatile u32_t cnc_timer_active;
 
-  /* Current x position */
-  volatile s32_t pos_x;
-  /* Current y position */
-  volatile s32_t pos_y;
-  /* Current z position */
-  volatile s32_t pos_z;
-
-  /* Offset x position */
-  volatile s32_t offs_pos_x;
-  /* Offset y position */
-  volatile s32_t offs_pos_y;
-  /* Offset z position */
-  volatile s32_t offs_pos_z;
+  /* Current position of each axis */
+  volatile s32_t pos[AXES_COUNT];
+  /* Offset position of each axis */
+  volatile s32_t offs_pos[AXES_COUNT];
 
   /* Current motion of all axes */
-  CNC_Motion_t cur_motion;
+  CNC_Regs_t cur_motion;
+  /* Current motion finished, as last seen by timer */
+  u32_t still;
 
   /* Pause granularity counter*/
   u32_t pause_tick;
+  /* Current path speed of planned motion, steps/s << CNC_FP_DECIMALS */
+  volatile u32_t speed;
+  /* Feed override in percent */
+  volatile u32_t feed_override;
+  /* Feed hold requested */
+  volatile u32_t feed_hold;
+  /* Scale of all axis frequencies, ramps towards target, CNC_FEED_Q */
+  volatile u32_t feed_scale;
+  volatile u32_t feed_target;
+  /* Feed scale change per tick, keeps current motion within accelerations */
+  u32_t feed_ramp;
+  /* Inverse and square of feed scale above 1.0, CNC_FEED_Q */
+  u32_t feed_inv;
+  u32_t feed_sq;
+  /* Rapid frequency increment per timer tick of each axis, from config */
+  u32_t rapid_tick[AXES_COUNT];
+#ifdef CONFIG_CNC_BRESENHAM
+  /* Axes stepping at end of current dominant axis period */
+  u32_t pulse_axes;
+#endif
+#ifdef CONFIG_CNC_STEP_TIMER
+  /* Step timer ticks until next engine run */
+  u32_t step_ticks;
+#endif
+#ifdef CONFIG_CNC_TRACE
+  /* Engine ticks since trace clear */
+  u32_t tick;
+  /* Last traced port word */
+  u32_t trace_last;
+  /* Port changes, written by timer and read by task */
+  CNC_Trace_t trace[CNC_TRACE_LEN];
+  volatile u32_t trace_wr;
+  volatile u32_t trace_rd;
+  /* Port changes not fitting in trace */
+  u32_t trace_lost;
+#endif
+#ifdef CONFIG_CNC_DMA_WAVE
+  /* Port BSRR word of current tick */
+  u32_t wave_word;
+  /* Port words streamed by dma, two halves of CNC_WAVE_BLOCK */
+  u32_t wave_buf[2*CNC_WAVE_BLOCK];
+#endif
 
   /* Pipeline active */
   volatile u32_t pipe_active;
   /* Pipelined motion definitions */
-  CNC_Motion_t pipe[CNC_PIPE_CAPACITY];
-  /* Index of first pipelined motion definition, at the end of current motion this will be active */
-  u32_t pipe_start;
-  /* Index of last pipelined motion definition */
-  u32_t pipe_end;
-  /* Number of pipelined motion definitions */
-  u32_t pipe_len;
+  CNC_Queued_t pipe[CNC_PIPE_CAPACITY];
+  /* Sequence number of first pipelined motion definition, at the end of
+     current motion this will be active. Only written by timer. */
+  volatile u32_t pipe_start;
+  /* Sequence number after last pipelined motion definition. Only written
+     by latching task. */
+  volatile u32_t pipe_end;
   cnc_pipe_callback pipe_cb;
 
-
-  /* Motion register latch */
-  CNC_Motion_t latch;
-  /* Flag indicating if something needs to be latched into pipeline when current motion has ended */
-  volatile u32_t latch_registers;
   /* Current flag id register */
   u32_t latch_id;
+  /* Machine position and axis directions at end of all latched motions,
+     only touched by latching task */
+  s32_t latch_pos[AXES_COUNT];
+  u32_t latch_dir;
+  /* Set when position, current motion or pipe change other than by
+     running or latching motions, latch_pos and latch_dir are then
+     recalculated */
+  volatile u32_t latch_stale;
+
+  /* Arc being fed into pipe, only touched by latching task */
+  CNC_Arc_t arc;
+  /* Plane axes of arc */
+  u8_t arc_axes[2];
+  /* Path speed and id of arc segments */
+  u32_t arc_feed;
+  u32_t arc_id;
+  /* Set while arc has segments left to latch */
+  volatile u32_t arc_active;
 
   /* Probe status flag */
-  u32_t probe_status;
-  /* Current probe count */
-  u32_t probe_count;
-  /* Current probe count */
-  u32_t cur_probe_count;
-  /* Z frequency on touch */
-  u32_t probe_z_freq_on_touch;
+  volatile u32_t probe_status;
+  /* Machine position at probe contact */
+  s32_t probe_pos[AXES_COUNT];
+  /* Set from probe contact or homing switch until current motion is
+     stopped and dropped */
+  volatile u32_t motion_stop;
+
+  /* Homing phase, CNC_HOMING_IDLE when not homing */
+  volatile u32_t home_phase;
+  /* Axes left to home */
+  u32_t home_axes;
+  /* Axis being homed */
+  volatile u32_t home_axis;
+  /* Set when switch closed during current seek, and position where */
+  volatile u32_t home_edge;
+  s32_t home_edge_pos;
+  /* Frequency of current homing move and its change per tick, homing
+     ramps on its own whatever feed override or hold */
+  u32_t home_freq;
+  u32_t home_ramp;
+  /* Set when last homing completed */
+  volatile u32_t homed;
+
+  /* Direction each axis last moved in, mask of positive axes */
+  volatile u32_t axis_dir;
+  /* Set while current motion takes up backlash of axes reversed by motion
+     at pipe head, machine position does not change meanwhile */
+  volatile u32_t take_up;
+  /* Axes mask of step pins high at last port write */
+  u32_t step_high;
+  /* Pipe statistics, written by timer */
+  CNC_Pipe_stats_t pipe_stats;
+  /* Set while motions run from pipe, cleared when pipe runs empty */
+  u32_t pipe_running;
+  /* Timer ticks of motions in pipe, and left of current motion, at full
+     feed */
+  volatile u32_t queue_ticks;
+  volatile u32_t cur_ticks;
+  /* Fraction of a tick current motion progressed at feed scale */
+  u32_t cur_frac;
 } machine;
 
+/* Homing phases */
+enum {
+  CNC_HOMING_IDLE = 0,
+  // pick next axis
+  CNC_HOMING_NEXT,
+  // fast towards switch
+  CNC_HOMING_SEEK,
+  // away from switch
+  CNC_HOMING_BACKOFF,
+  // slowly towards switch
+  CNC_HOMING_LOCATE,
+};
+
 
 void CNC_init(cnc_sr_callback sr_f, cnc_pipe_callback pipe_f,
-    cnc_pos_callback pos_f, cnc_offs_callback offs_f) {
-  DBG(D_APP, D_DEBUG, "CNC init\n");
+    cnc_pos_callback pos_f, cnc_offs_callback offs_f, cnc_probe_callback probe_f) {
+  DBG(D_APP, D_DEBUG, "CNC init, pipe %i motions, %i bytes\n",
+      CNC_PIPE_CAPACITY, sizeof(machine.pipe));
 
   machine.cnc_timer_active = FALSE;
   memset(&machine, 0, sizeof(machine));
   machine.sr_err_mask = 0xff;
   machine.pipe_active = TRUE;
   machine.probe_status = CNC_PROBE_DISABLED;
+  machine.step_high = (1<<AXES_COUNT) - 1;
   machine.sr_cb = sr_f;
   machine.pipe_cb = pipe_f;
   machine.pos_cb = pos_f;
   machine.offs_cb = offs_f;
+  machine.probe_cb = probe_f;
+#ifdef CONFIG_CNC_STEP_TIMER
+  machine.step_ticks = CNC_TIMER_FREQ/1000;
+#endif
+  machine.sr_dirty = TRUE;
+  machine.feed_scale = CNC_FEED_ONE;
+  machine.feed_ramp = CNC_FEED_ONE;
 
   (void)CNC_reset();
 }
 
+// stops current motion at once
+static void stop_imm() {
+  static const s32_t steps[AXES_COUNT] = {0};
+  static const u32_t freq[AXES_COUNT] = {0};
+  CNC_set_imm(steps, freq);
+}
+
+// derives per tick frequency increment of rapids from rapid acceleration,
+// no limit ramps to max frequency at once
+static void set_rapid_ramp(int a) {
+  u32_t acc = machine.config.rapid_acc[a];
+  machine.rapid_tick[a] = acc == 0 ? CNC_TIMER_FULL :
+      MAX(1, (u32_t)(((u64_t)acc << CNC_FP_DECIMALS) / CNC_TIMER_FREQ));
+}
+
+static void reset_pipe_stats() {
+  machine.pipe_stats.underruns = 0;
+  machine.pipe_stats.min_depth = CNC_PIPE_CAPACITY;
+  machine.pipe_stats.motions = 0;
+}
+
 u32_t CNC_reset() {
+  int a;
   CNC_set_enabled(FALSE);
   CNC_pipeline_flush();
-  CNC_set_regs_imm(0,0,0,0,0,0);
-  CNC_set_probe(FALSE, 0, 0);
+  stop_imm();
+  CNC_set_probe(FALSE);
+  machine.motion_stop = FALSE;
+  machine.home_phase = CNC_HOMING_IDLE;
+  machine.homed = FALSE;
   CNC_pipeline_enable(FALSE);
+  CNC_feed_hold(FALSE);
+  (void)CNC_set_feed_override(100);
   CNC_disable_error(0xff);
-  machine.config.max_freq[X_AXIS] = CNC_MAX_STEP_FREQ;
-  machine.config.max_freq[Y_AXIS] = CNC_MAX_STEP_FREQ;
-  machine.config.max_freq[Z_AXIS] = CNC_MAX_STEP_FREQ;
-  machine.config.rapid_delta[X_AXIS] = CNC_RAPID_ACC_DEC;
-  machine.config.rapid_delta[Y_AXIS] = CNC_RAPID_ACC_DEC;
-  machine.config.rapid_delta[Z_AXIS] = CNC_RAPID_ACC_DEC;
+  for (a = 0; a < AXES_COUNT; a++) {
+    machine.config.max_freq[a] = CNC_MAX_STEP_FREQ;
+    machine.config.rapid_acc[a] = CNC_RAPID_ACC;
+    set_rapid_ramp(a);
+    machine.config.acc[a] = CNC_MAX_ACC;
+    machine.config.start_freq[a] = CNC_START_FREQ;
+    machine.config.jerk[a] = CNC_JERK;
+  }
+  for (a = 0; a < AXES_COUNT; a++) {
+    machine.config.backlash[a] = 0;
+    machine.config.backlash_freq[a] = CNC_BACKLASH_FREQ;
+  }
+  for (a = 0; a < AXES_COUNT; a++) {
+    machine.config.home_seek[a] = CNC_HOME_SEEK_FREQ;
+    machine.config.home_locate[a] = CNC_HOME_LOCATE_FREQ;
+    machine.config.home_backoff[a] = CNC_HOME_BACKOFF;
+    machine.config.home_travel[a] = CNC_HOME_TRAVEL;
+  }
+  machine.config.home_dir = 0;
+  machine.config.junction_dev = CNC_JUNCTION_DEV;
+  machine.config.arc_tolerance = CNC_ARC_TOLERANCE;
+  machine.config.slow_depth = CNC_SLOW_DEPTH;
+  machine.config.slow_time = CNC_SLOW_TIME;
+  enter_critical();
+  reset_pipe_stats();
+  exit_critical();
   return TRUE;
 }
 
-static bool update_axis_regs(CNC_Axis_t axis_def, CNC_Vector_t* pAxis, u32_t rapid) {
-  if (pAxis->step_count == 0) {
+static u32_t axis_inc(const CNC_Regs_t *r, CNC_Axis_t a) {
+  u32_t inc = r->step_freq[a] + r->step_freq_adj[a];
+  u32_t scale = machine.feed_scale;
+  if (scale != CNC_FEED_ONE) {
+    inc = (u32_t)(((u64_t)inc * scale) >> CNC_FEED_Q);
+  }
+  return MIN(((machine.config.max_freq[a]) << CNC_FP_DECIMALS), inc);
+}
+
+// Feed scale change per tick keeping each axis of current motion within its
+// acceleration at the highest frequency of the motion. Scaling frequency f
+// by s changing at rate ds accelerates the axis by f*ds, whatever s is.
+static u32_t feed_ramp(const CNC_Regs_t *r) {
+  u32_t ramp = CNC_FEED_ONE;
+  int a;
+  for (a = 0; a < AXES_COUNT; a++) {
+    u32_t acc = machine.config.acc[a];
+    u32_t f;
+    if (r->step_count[a] == 0 || acc == 0) {
+      continue;
+    }
+    if (r->rapid) {
+      f = machine.config.max_freq[a];
+    } else if (r->profile.entry) {
+      f = (u32_t)(((u64_t)r->profile.peak * r->step_factor[a]) >>
+          (CNC_PLAN_FACTOR_Q + CNC_FP_DECIMALS));
+    } else {
+      f = r->step_freq[a] >> CNC_FP_DECIMALS;
+    }
+    if (f == 0) {
+      continue;
+    }
+    u32_t ra = (u32_t)(((u64_t)acc << CNC_FEED_Q) / ((u64_t)f * CNC_TIMER_FREQ));
+    ramp = MIN(ramp, MAX(1, ra));
+  }
+  return ramp;
+}
+
+// feed scale the timer ramps to, zero when held or stopping on probe contact,
+// full feed while homing
+static void set_feed_target() {
+  if (machine.home_phase != CNC_HOMING_IDLE) {
+    machine.feed_target = CNC_FEED_ONE;
+  } else {
+    machine.feed_target = machine.feed_hold || machine.motion_stop ? 0 :
+        (u32_t)(((u64_t)machine.feed_override << CNC_FEED_Q) / 100);
+  }
+  machine.sr_dirty = TRUE;
+}
+
+// ramps feed scale towards target
+static void update_feed(u32_t ticks) {
+  u32_t s = machine.feed_scale;
+  u32_t t = machine.feed_target;
+  u64_t d = (u64_t)machine.feed_ramp * ticks;
+  if (s < t) {
+    s = d >= t - s ? t : s + (u32_t)d;
+  } else {
+    s = d >= s - t ? t : s - (u32_t)d;
+  }
+  machine.feed_scale = s;
+  if (s > CNC_FEED_ONE) {
+    machine.feed_inv = (u32_t)(((u64_t)CNC_FEED_ONE << CNC_FEED_Q) / s);
+    machine.feed_sq = (u32_t)(((u64_t)s * s) >> CNC_FEED_Q);
+  }
+  if (s == t) {
+    // held or back at feed
+    machine.sr_dirty = TRUE;
+  }
+}
+
+// frequency adjustment where rapid axis reaches its max frequency
+static inline u32_t rapid_top(const CNC_Regs_t *r, CNC_Axis_t a) {
+  u32_t max = machine.config.max_freq[a] << CNC_FP_DECIMALS;
+  return max > r->step_freq[a] ? max - r->step_freq[a] : 0;
+}
+
+// ramps rapid axis frequency with constant acceleration in time, up from
+// its start frequency until it has as many steps left as it took
+// accelerating, then down again
+static inline void update_rapid(CNC_Regs_t *r, CNC_Axis_t a, u32_t ticks) {
+  u64_t dv = (u64_t)machine.rapid_tick[a] * ticks;
+  u32_t adj = r->step_freq_adj[a];
+  if (r->step_count[a] > r->ramp_steps[a]) {
+    u32_t top = rapid_top(r, a);
+    adj = adj + dv >= top ? top : adj + (u32_t)dv;
+  } else {
+    adj = adj > dv ? adj - (u32_t)dv : 0;
+  }
+  r->step_freq_adj[a] = adj;
+}
+
+// advances axis timer, returns TRUE if axis steps. Registers are worked on
+// in locals and written back once.
+static inline bool update_axis_regs(CNC_Regs_t *r, CNC_Axis_t a, u32_t rapid, u32_t ticks) {
+  u32_t count = r->step_count[a];
+  if (count == 0) {
     return FALSE;
   }
-  pAxis->timer_counter +=
-      MIN(
-          ((machine.config.max_freq[axis_def]) << CNC_FP_DECIMALS),
-          (pAxis->step_freq + pAxis->step_freq_adj));
-
-  if (pAxis->timer_counter >= (CNC_TIMER_FREQ << CNC_FP_DECIMALS)) {
-    pAxis->timer_counter -= (CNC_TIMER_FREQ << CNC_FP_DECIMALS);
-    if (pAxis->step_count > 0) {
-      pAxis->step_count--;
-      if (rapid) {
-        if (pAxis->step_count >= pAxis->step_count_half) {
-          pAxis->step_freq_adj += machine.config.rapid_delta[axis_def];
-        } else {
-          pAxis->step_freq_adj -= machine.config.rapid_delta[axis_def];
-        }
-      }
-      if (pAxis->step_count == 0) {
-        // reached end of travel, reset motion registers
-        pAxis->step_freq = 0;
-        pAxis->step_freq_adj = 0;
-        pAxis->timer_counter = 0;
-      }
+  if (rapid) {
+    update_rapid(r, a, ticks);
+  }
+  u32_t counter = r->timer_counter[a] + axis_inc(r, a) * ticks;
+  if (counter < CNC_TIMER_FULL) {
+    r->timer_counter[a] = counter;
+    return FALSE;
+  }
+  counter -= CNC_TIMER_FULL;
+  count--;
+  if (rapid && count > r->ramp_steps[a] && r->step_freq_adj[a] < rapid_top(r, a)) {
+    r->ramp_steps[a]++;
+  }
+  if (count == 0) {
+    // reached end of travel, reset motion registers
+    r->step_freq[a] = 0;
+    r->step_freq_adj[a] = 0;
+    counter = 0;
+  }
+  r->timer_counter[a] = counter;
+  r->step_count[a] = count;
+  return TRUE;
+}
+
+// follows s-curve velocity table, speed moves from start speed of current
+// transition towards its end speed as table phase advances
+static u32_t update_scurve(CNC_Regs_t *r, u32_t decel_steps, u32_t ticks, u32_t slow) {
+  CNC_Profile_t *p = &r->profile;
+  u32_t to, inc;
+  if (!p->decel && r->step_count[p->dom] <= decel_steps) {
+    // decelerate from wherever acceleration got
+    p->decel = TRUE;
+    p->from = machine.speed;
+    p->phase = 0;
+  }
+  if (p->decel) {
+    to = p->exit;
+    inc = p->dec_phase_inc;
+  } else {
+    to = p->peak;
+    inc = p->acc_phase_inc;
+  }
+  if (p->phase >= CNC_PLAN_PHASE_END) {
+    return to;
+  }
+  u32_t adv = inc * ticks;
+  if (slow != CNC_FEED_ONE) {
+    adv = (u32_t)(((u64_t)adv * slow) >> CNC_FEED_Q);
+  }
+  p->phase += adv;
+  if (p->phase >= CNC_PLAN_PHASE_END) {
+    return to;
+  }
+  u32_t seg = p->phase >> CNC_PLAN_PHASE_Q;
+  u32_t frac = p->phase & ((1 << CNC_PLAN_PHASE_Q) - 1);
+  u32_t s0 = CNC_PLAN_scurve[seg];
+  u32_t s = s0 + (((CNC_PLAN_scurve[seg + 1] - s0) * frac) >> CNC_PLAN_PHASE_Q);
+  s64_t d = (s64_t)to - (s64_t)p->from;
+  return (u32_t)((s64_t)p->from + ((d * s) >> CNC_PLAN_SCURVE_Q));
+}
+
+static void update_profile(CNC_Regs_t *r, u32_t ticks) {
+  CNC_Profile_t *p = &r->profile;
+  u32_t v = machine.speed;
+  u32_t decel_steps = p->decel_steps;
+  u32_t slow = CNC_FEED_ONE;
+  if (machine.feed_scale > CNC_FEED_ONE) {
+    // feed override above 100%, axes run faster than profile. Slow profile
+    // down by feed scale to keep axis accelerations, axes then need feed
+    // scale squared the distance to decelerate.
+    slow = machine.feed_inv;
+    decel_steps = (u32_t)MIN(0xffffffff, ((u64_t)decel_steps * machine.feed_sq) >> CNC_FEED_Q);
+  }
+  if (p->acc_phase_inc) {
+    v = update_scurve(r, decel_steps, ticks, slow);
+  } else {
+    u32_t dv = p->acc_tick * ticks;
+    if (slow != CNC_FEED_ONE) {
+      dv = (u32_t)(((u64_t)dv * slow) >> CNC_FEED_Q);
+    }
+    if (r->step_count[p->dom] <= decel_steps) {
+      v = v > p->exit + dv ? v - dv : p->exit;
+    } else if (v < p->nominal) {
+      v = v + dv < p->nominal ? v + dv : p->nominal;
+    }
+  }
+  machine.speed = v;
+#ifdef CONFIG_CNC_BRESENHAM
+  // minor axes follow dominant axis
+  r->step_freq[p->dom] = (u32_t)(((u64_t)v * r->step_factor[p->dom]) >> CNC_PLAN_FACTOR_Q);
+#else
+#define PROFILE_AXIS(a) \
+  if (r->step_count[a] > 0) { \
+    r->step_freq[a] = (u32_t)(((u64_t)v * r->step_factor[a]) >> CNC_PLAN_FACTOR_Q); \
+  }
+  CNC_FOR_EACH_AXIS(PROFILE_AXIS)
+#undef PROFILE_AXIS
+#endif
+}
+
+#ifdef CONFIG_CNC_BRESENHAM
+// Returns axes stepping at next dominant axis step
+static u32_t next_pulse_axes(const CNC_Regs_t *r) {
+  u8_t dom = r->profile.dom;
+  u32_t dom_total = r->step_total[dom];
+  u32_t axes = 0;
+  if (r->step_count[dom] != 0) {
+    axes = (1<<dom);
+#define NEXT_AXIS(a) \
+    if (a != dom && r->step_count[a] != 0 && \
+        r->bres_err[a] + r->step_total[a] >= dom_total) { \
+      axes |= (1<<a); \
     }
-    return TRUE;
+    CNC_FOR_EACH_AXIS(NEXT_AXIS)
+#undef NEXT_AXIS
   }
-  return FALSE;
+  return axes;
 }
 
-static void copy_axis_regs(CNC_Vector_t* pAxisDest, CNC_Vector_t* pAxisSrc) {
-  pAxisDest->step_freq = pAxisSrc->step_freq;
-  pAxisDest->step_freq_adj = pAxisSrc->step_freq_adj;
-  pAxisDest->dir = pAxisSrc->dir;
-  pAxisDest->step_count = pAxisSrc->step_count;
-  pAxisDest->step_count_half = pAxisSrc->step_count_half;
+static u32_t update_coordinated_regs(CNC_Regs_t *r, u32_t ticks) {
+  u8_t dom = r->profile.dom;
+  u32_t ov_axes = 0;
+  if (update_axis_regs(r, dom, FALSE, ticks)) {
+    u32_t dom_total = r->step_total[dom];
+    ov_axes = (1<<dom);
+#define BRES_STEP_AXIS(a) \
+    if (a != dom && r->step_count[a] != 0) { \
+      u32_t err = r->bres_err[a] + r->step_total[a]; \
+      if (err >= dom_total) { \
+        err -= dom_total; \
+        r->step_count[a]--; \
+        ov_axes |= (1<<a); \
+      } \
+      r->bres_err[a] = err; \
+    }
+    CNC_FOR_EACH_AXIS(BRES_STEP_AXIS)
+#undef BRES_STEP_AXIS
+    machine.pulse_axes = next_pulse_axes(r);
+  }
+  return ov_axes;
+}
+#endif
+
+// Derives current motion registers from a queued motion
+static void load_motion(const CNC_Queued_t *q) {
+  CNC_Regs_t *r = &machine.cur_motion;
+  u32_t dom_steps = q->steps[q->plan.dom];
+  u32_t moving = 0;
+  int a;
+  r->id = q->id;
+  r->rapid = (q->flags & CNC_QUEUED_RAPID) != 0;
+  r->dir_axes = q->flags & ((1<<AXES_COUNT) - 1);
+  for (a = 0; a < AXES_COUNT; a++) {
+    u32_t steps = q->steps[a];
+    moving |= steps ? (1<<a) : 0;
+    r->step_count[a] = steps;
+    r->step_total[a] = steps;
+    r->ramp_steps[a] = 0;
+    r->step_freq[a] = steps == 0 ? 0 : (u32_t)(((u64_t)q->rate * steps) / dom_steps);
+    r->step_freq_adj[a] = 0;
+    r->step_factor[a] = CNC_PLAN_factor(q, a);
+  }
+  machine.axis_dir = (machine.axis_dir & ~moving) | (r->dir_axes & moving);
+  machine.take_up = FALSE;
+  if (q->flags & CNC_QUEUED_PAUSE) {
+    r->pause = q->rate;
+    machine.pause_tick = 0;
+  } else {
+    r->pause = 0;
+  }
+  if (q->plan.length) {
+    // enter planned motion at speed of previous motion if slower
+    u32_t entry = machine.speed == 0 ?
+        q->plan.floor :
+        MIN(machine.speed >> CNC_FP_DECIMALS, q->plan.entry);
+    CNC_PLAN_profile(&r->profile, q, MAX(1, entry), q->plan.exit);
+    machine.speed = r->profile.entry;
+  } else {
+    r->profile.entry = 0;
+    machine.speed = 0;
+  }
+  machine.feed_ramp = feed_ramp(r);
 }
 
-static void copy_motion(CNC_Motion_t* pMotionDest, CNC_Motion_t* pMotionSrc) {
-  pMotionDest->id = pMotionSrc->id;
-  pMotionDest->rapid = pMotionSrc->rapid;
-  copy_axis_regs(&pMotionDest->vector[X_AXIS], &pMotionSrc->vector[X_AXIS]);
-  copy_axis_regs(&pMotionDest->vector[Y_AXIS], &pMotionSrc->vector[Y_AXIS]);
-  copy_axis_regs(&pMotionDest->vector[Z_AXIS], &pMotionSrc->vector[Z_AXIS]);
+// Returns axes having backlash a queued motion reverses against given
+// directions
+static u32_t backlash_axes(const CNC_Queued_t *q, u32_t dir) {
+  u32_t rev = 0;
+  int a;
+  for (a = 0; a < AXES_COUNT; a++) {
+    if (q->steps[a] && machine.config.backlash[a] &&
+        ((q->flags ^ dir) & (1<<a))) {
+      rev |= (1<<a);
+    }
+  }
+  return rev;
+}
 
-  if (pMotionSrc->pause > 0) {
-    if (pMotionDest == &machine.cur_motion) {
-      machine.pause_tick = 0;
+// Loads backlash take up of axes reversed by queued motion as current
+// motion, returns FALSE if no axis having backlash is reversed. Taken up
+// axes step at backlash frequency from standstill, the queued motion is
+// entered from standstill after.
+static bool load_take_up(const CNC_Queued_t *q) {
+  CNC_Regs_t *r = &machine.cur_motion;
+  u32_t rev = backlash_axes(q, machine.axis_dir);
+  u32_t ticks = 0;
+  int a;
+  if (rev == 0) {
+    return FALSE;
+  }
+  r->id = q->id;
+  r->rapid = FALSE;
+  r->pause = 0;
+  r->profile.entry = 0;
+  r->dir_axes = q->flags & ((1<<AXES_COUNT) - 1);
+  for (a = 0; a < AXES_COUNT; a++) {
+    u32_t steps = (rev & (1<<a)) ? machine.config.backlash[a] : 0;
+    r->step_count[a] = steps;
+    r->step_total[a] = steps;
+    r->ramp_steps[a] = 0;
+    r->step_freq[a] = steps == 0 ? 0 : machine.config.backlash_freq[a] << CNC_FP_DECIMALS;
+    r->step_freq_adj[a] = 0;
+    r->step_factor[a] = 0;
+    if (steps) {
+      ticks = MAX(ticks, (u32_t)(((u64_t)steps * CNC_TIMER_FREQ) /
+          MAX(1, machine.config.backlash_freq[a])));
     }
   }
-  pMotionDest->pause = pMotionSrc->pause;
+  machine.axis_dir = (machine.axis_dir & ~rev) | (r->dir_axes & rev);
+  machine.take_up = TRUE;
+  machine.cur_ticks = ticks;
+  machine.speed = 0;
+  machine.feed_ramp = feed_ramp(r);
+  return TRUE;
 }
 
-void CNC_timer() {
-  u32 sr = CNC_get_status();
-  if ((machine.sr ^ sr) & machine.sr_mask) {
+// drops what is left of current motion, called from timer or with timer
+// held off
+static void drop_motion(CNC_Regs_t *r) {
+  int a;
+  for (a = 0; a < AXES_COUNT; a++) {
+    // a step pin low halfway through its period rises at next port write
+    // all the same, count that step
+    if ((machine.step_high & (1<<a)) == 0 && !machine.take_up) {
+      machine.pos[a] += (r->dir_axes & (1<<a)) ? 1 : -1;
+    }
+    r->step_count[a] = 0;
+    r->step_freq[a] = 0;
+    r->step_freq_adj[a] = 0;
+    r->timer_counter[a] = 0;
+  }
+  r->pause = 0;
+  r->profile.entry = 0;
+  machine.speed = 0;
+  machine.motion_stop = FALSE;
+  machine.take_up = FALSE;
+  machine.latch_stale = TRUE;
+  machine.cur_ticks = 0;
+  set_feed_target();
+}
+
+static bool limit_closed(CNC_Axis_t a) {
+  return (CNC_GPIO_LIMIT_READ() & axis_limit_pin[a]) == 0;
+}
+
+// moves single axis towards or away from its home switch, accelerating
+// from stand still. Called from timer.
+static void home_move(CNC_Regs_t *r, CNC_Axis_t a, u32_t towards, u32_t steps, u32_t freq) {
+  int b;
+  u32_t positive = ((machine.config.home_dir >> a) & 1) == towards;
+  drop_motion(r);
+  r->id = 0;
+  r->rapid = FALSE;
+  r->dir_axes = positive ? (1<<a) : 0;
+  for (b = 0; b < AXES_COUNT; b++) {
+    r->step_total[b] = 0;
+    r->step_factor[b] = 0;
+  }
+  r->step_count[a] = steps;
+  r->step_total[a] = steps;
+  r->step_freq[a] = MIN(freq, machine.config.start_freq[a]) << CNC_FP_DECIMALS;
+  machine.axis_dir = (machine.axis_dir & ~(1<<a)) | r->dir_axes;
+  machine.home_freq = freq << CNC_FP_DECIMALS;
+  machine.home_ramp = machine.config.acc[a] == 0 ? CNC_TIMER_FULL :
+      MAX(1, (u32_t)(((u64_t)machine.config.acc[a] << CNC_FP_DECIMALS) / CNC_TIMER_FREQ));
+  // homing moves at full feed, nothing moves meanwhile so scale is set at once
+  machine.feed_scale = CNC_FEED_ONE;
+  set_feed_target();
+  machine.sr_dirty = TRUE;
+}
+
+// ramps frequency of homing axis from start frequency up to homing frequency
+// within axis acceleration, and down to a stop once switch edge is seen.
+// Called from timer.
+static void update_home(CNC_Regs_t *r, u32_t ticks) {
+  CNC_Axis_t a = machine.home_axis;
+  u32_t f = r->step_freq[a];
+  u32_t d = (u32_t)MIN(0xffffffff, (u64_t)machine.home_ramp * ticks);
+  if (r->step_count[a] == 0) {
+    return;
+  }
+  if (machine.motion_stop) {
+    u32_t stop = MIN(machine.home_freq,
+        machine.config.start_freq[a] << CNC_FP_DECIMALS);
+    if (f <= stop || f - stop <= d) {
+      drop_motion(r);
+      return;
+    }
+    f -= d;
+  } else if (f < machine.home_freq) {
+    f = machine.home_freq - f <= d ? machine.home_freq : f + d;
+  }
+  r->step_freq[a] = f;
+}
+
+// ends homing, on failure machine is put in error
+static void home_end(CNC_Regs_t *r, u32_t ok) {
+  drop_motion(r);
+  machine.home_phase = CNC_HOMING_IDLE;
+  machine.home_axes = 0;
+  machine.homed = ok;
+  // back to feed, nothing moves so again at once, ramps up with next motion
+  // if above full feed
+  set_feed_target();
+  machine.feed_scale = MIN(machine.feed_target, CNC_FEED_ONE);
+  if (!ok) {
+    machine.sr_err |= (1<<CNC_ERROR_BIT_HOMING);
+  }
+  machine.sr_dirty = TRUE;
+}
+
+// advances homing when current homing motion has ended. Called from timer.
+static void home_next(CNC_Regs_t *r) {
+  CNC_Axis_t a = machine.home_axis;
+  const CNC_Config_t *cfg = &machine.config;
+  switch (machine.home_phase) {
+  case CNC_HOMING_NEXT:
+  {
+    int i;
+    for (i = 0; i < AXES_COUNT; i++) {
+      if (machine.home_axes & (1<<home_order[i])) {
+        break;
+      }
+    }
+    if (i == AXES_COUNT) {
+      home_end(r, TRUE);
+      break;
+    }
+    a = home_order[i];
+    machine.home_axes &= ~(1<<a);
+    machine.home_axis = a;
+    machine.home_phase = CNC_HOMING_SEEK;
+    if (limit_closed(a)) {
+      // already on switch, no edge to seek
+      machine.home_edge = TRUE;
+      home_next(r);
+    } else {
+      machine.home_edge = FALSE;
+      home_move(r, a, TRUE, cfg->home_travel[a], cfg->home_seek[a]);
+    }
+    break;
+  }
+  case CNC_HOMING_SEEK:
+    if (!machine.home_edge) {
+      // travelled all the way without finding switch
+      home_end(r, FALSE);
+      break;
+    }
+    machine.home_phase = CNC_HOMING_BACKOFF;
+    home_move(r, a, FALSE, cfg->home_backoff[a], cfg->home_seek[a]);
+    break;
+  case CNC_HOMING_BACKOFF:
+    if (limit_closed(a)) {
+      // switch still closed after back off
+      home_end(r, FALSE);
+      break;
+    }
+    machine.home_edge = FALSE;
+    machine.home_phase = CNC_HOMING_LOCATE;
+    home_move(r, a, TRUE, 2*cfg->home_backoff[a], cfg->home_locate[a]);
+    break;
+  case CNC_HOMING_LOCATE:
+    if (!machine.home_edge) {
+      home_end(r, FALSE);
+      break;
+    }
+    // zero where switch closed, whatever the axis travelled after. Position
+    // is stored by the persisting task, never from timer.
+    machine.pos[a] -= machine.home_edge_pos;
+    machine.latch_stale = TRUE;
+    machine.home_phase = CNC_HOMING_NEXT;
+    home_next(r);
+    break;
+  }
+}
+
+// Number of motions in pipe, safe from both timer and latching task
+static u32_t pipe_len() {
+  return machine.pipe_end - machine.pipe_start;
+}
+
+#ifdef CONFIG_CNC_TRACE
+static void trace_port(u32_t bsrr) {
+  if (bsrr == machine.trace_last) {
+    return;
+  }
+  machine.trace_last = bsrr;
+  u32_t wr = machine.trace_wr;
+  if (wr - machine.trace_rd >= CNC_TRACE_LEN) {
+    machine.trace_lost++;
+    return;
+  }
+  CNC_Trace_t *t = &machine.trace[wr & (CNC_TRACE_LEN - 1)];
+  t->tick = machine.tick;
+  t->bsrr = bsrr;
+  CNC_PIPE_BARRIER();
+  machine.trace_wr = wr + 1;
+}
+#endif
+
+static void port_def(u32_t set, u32_t reset) {
+#ifdef CONFIG_CNC_TRACE
+  trace_port(set | (reset << 16));
+#endif
+#ifdef CONFIG_CNC_DMA_WAVE
+  // port is written by dma, keep word
+  machine.wave_word = set | (reset << 16);
+#else
+  CNC_GPIO_DEF(set, reset);
+#endif
+}
+
+// recalculates status register after a state transition, reporting any
+// change for deferred handling
+static void update_status() {
+  machine.sr_dirty = FALSE;
+  u32_t sr = CNC_get_status();
+  if (sr != machine.sr) {
     machine.sr = sr;
-    // report status change
     if (machine.sr_cb) {
       machine.sr_cb(sr);
     }
-  } else {
-    machine.sr = sr;
+  }
+}
+
+// runs the cnc engine for given number of cnc timer ticks
+static void cnc_timer_ticks(u32_t ticks) {
+  CNC_Regs_t *r = &machine.cur_motion;
+#ifdef CONFIG_CNC_TRACE
+  machine.tick += ticks;
+#endif
+  if (machine.sr_dirty) {
+    update_status();
   }
 
   if (machine.sr_err & machine.sr_err_mask) {
-    LED_disable(LED_CNC_WORK_BIT);
-    LED_blink_single(LED_CNC_DISABLE_BIT, 16, 3, 1);
-    LED_blink(LED_ERROR1 | LED_ERROR2 | LED_ERROR3, 32, 20, 1);
     return;
   }
   if (!machine.cnc_timer_active) {
     // prevent any tampering with cnc registers and control port
-    LED_blink_single(LED_CNC_DISABLE_BIT, 16, 3, 1);
-    LED_blink_single(LED_CNC_WORK_BIT, 64, 1, 1);
     return;
   }
 
-  if (sr & (1<<CNC_STATUS_BIT_MOVEMENT_PAUSE)) {
-    LED_blink_single(LED_CNC_WORK_BIT, 16, 8, 1);
-  } else if (sr & (1<<CNC_STATUS_BIT_MOVEMENT_STILL)) {
-    LED_blink_single(LED_CNC_WORK_BIT, 16, 1, 1);
-  } else if ((sr & ((1<<CNC_STATUS_BIT_MOVEMENT_PAUSE) | (1<<CNC_STATUS_BIT_MOVEMENT_STILL))) == 0) {
-    LED_blink_single(LED_CNC_WORK_BIT, 16, 15, 1);
-  }
-
-  // probe sense control
-  if (machine.probe_status != CNC_PROBE_DISABLED && machine.probe_status != CNC_PROBE_CONTACT) {
-    int triggerPort = 0;//GP3DAT & 0xff;
-    if ((triggerPort & (1<<1)) != 0) {
-      machine.cur_motion.vector[Z_AXIS].step_freq = machine.probe_z_freq_on_touch;
-      machine.probe_status = CNC_PROBE_SENSE;
-      machine.cur_probe_count++;
-      if (machine.cur_probe_count >= machine.probe_count) {
-        machine.probe_status = CNC_PROBE_CONTACT;
-        CNC_set_regs_imm(0,0,0,0,0,0);
-      }
-    } else {
-      machine.cur_probe_count = 0;
-    }
+  if (machine.feed_scale != machine.feed_target) {
+    update_feed(ticks);
+  }
+  u32_t held = machine.feed_scale == 0;
+  if (held && machine.motion_stop) {
+    // probing motion stopped after contact
+    drop_motion(r);
+  }
+  if (machine.home_phase != CNC_HOMING_IDLE) {
+    update_home(r, ticks);
   }
 
   // movement
@@ -226,118 +933,249 @@ void CNC_timer() {
     // axes timer overflow flags
     u32_t ov_axes = 0;
 
+    // time left of current motion runs at feed scale
+    if (!held && machine.cur_ticks) {
+      u32_t t = ticks;
+      if (machine.feed_scale != CNC_FEED_ONE) {
+        u64_t f = (u64_t)ticks * machine.feed_scale + machine.cur_frac;
+        t = (u32_t)(f >> CNC_FEED_Q);
+        machine.cur_frac = (u32_t)f & (CNC_FEED_ONE - 1);
+      }
+      machine.cur_ticks -= MIN(t, machine.cur_ticks);
+    }
+
     // check pause
-    if (machine.cur_motion.pause > 0) {
+    if (held) {
+      // feed hold, current motion stays as it is
+    } else if (r->pause > 0) {
       // paused, no motion
       if (machine.pause_tick > 0) {
-        machine.pause_tick--;
+        machine.pause_tick -= MIN(ticks, machine.pause_tick);
       } else {
-        machine.cur_motion.pause--;
+        r->pause--;
         machine.pause_tick = CNC_TIMER_FREQ/1000;
       }
     } else {
+      // follow planned velocity profile
+      if (r->profile.entry) {
+        update_profile(r, ticks);
+      }
       // control registers calculations
-      ov_axes |=
-          update_axis_regs(X_AXIS, &machine.cur_motion.vector[X_AXIS], machine.cur_motion.rapid) ?
-              (1<<X_AXIS) : 0;
-      ov_axes |=
-          update_axis_regs(Y_AXIS, &machine.cur_motion.vector[Y_AXIS], machine.cur_motion.rapid) ?
-              (1<<Y_AXIS) : 0;
-      ov_axes |=
-          update_axis_regs(Z_AXIS, &machine.cur_motion.vector[Z_AXIS], machine.cur_motion.rapid) ?
-              (1<<Z_AXIS) : 0;
-    }
-
-    // control port setting
-    bool f_step_x = machine.cur_motion.vector[X_AXIS].timer_counter <= ((CNC_TIMER_FREQ
-        << CNC_FP_DECIMALS) / 2);
-    bool f_step_y = machine.cur_motion.vector[Y_AXIS].timer_counter <= ((CNC_TIMER_FREQ
-        << CNC_FP_DECIMALS) / 2);
-    bool f_step_z = machine.cur_motion.vector[Z_AXIS].timer_counter <= ((CNC_TIMER_FREQ
-        << CNC_FP_DECIMALS) / 2);
-
-    CNC_GPIO_DEF(
-        // set
-        (machine.cur_motion.vector[X_AXIS].dir ? CNC_GPIO_DIR_X : 0) |
-        (f_step_x ? CNC_GPIO_STEP_X : 0) |
-        (machine.cur_motion.vector[Y_AXIS].dir ? CNC_GPIO_DIR_Y : 0) |
-        (f_step_y ? CNC_GPIO_STEP_Y : 0) |
-        (machine.cur_motion.vector[Z_AXIS].dir ? CNC_GPIO_DIR_Z : 0) |
-        (f_step_z ? CNC_GPIO_STEP_Z : 0),
-        // reset
-        (machine.cur_motion.vector[X_AXIS].dir ? 0 : CNC_GPIO_DIR_X ) |
-        (f_step_x ? 0 : CNC_GPIO_STEP_X ) |
-        (machine.cur_motion.vector[Y_AXIS].dir ? 0 : CNC_GPIO_DIR_Y) |
-        (f_step_y ? 0 : CNC_GPIO_STEP_Y) |
-        (machine.cur_motion.vector[Z_AXIS].dir ? 0 : CNC_GPIO_DIR_Z ) |
-        (f_step_z ? 0 : CNC_GPIO_STEP_Z)
-    );
-
-    // position calculations
-    if (ov_axes & (1<<X_AXIS)) {
-      machine.pos_x += ((machine.cur_motion.vector[X_AXIS].dir) ? 1 : -1);
-    }
-    if (ov_axes & (1<<Y_AXIS)) {
-      machine.pos_y += ((machine.cur_motion.vector[Y_AXIS].dir) ? 1 : -1);
-    }
-    if (ov_axes & (1<<Z_AXIS)) {
-      machine.pos_z += ((machine.cur_motion.vector[Z_AXIS].dir) ? 1 : -1);
-    }
-    if (machine.pos_cb && (ov_axes != 0)) {
-      machine.pos_cb(machine.pos_x, machine.pos_y, machine.pos_z);
-    }
-  }
-
-  // motion pipeline execution
-  if (machine.pipe_active
-      && machine.cur_motion.vector[X_AXIS].step_count == 0
-      && machine.cur_motion.vector[Y_AXIS].step_count == 0
-      && machine.cur_motion.vector[Z_AXIS].step_count == 0
-      && machine.cur_motion.pause == 0) {
-    // no current motion, something in the pipe?
-    if (machine.pipe_len > 0) {
-      copy_motion(&machine.cur_motion, &machine.pipe[machine.pipe_start]);
-      machine.pipe[machine.pipe_start].id = 0; // clear id of used motion
-
-      machine.pipe_start++;
-      if (machine.pipe_start >= CNC_PIPE_CAPACITY) {
-        machine.pipe_start = 0;
+#ifdef CONFIG_CNC_BRESENHAM
+      if (r->profile.entry) {
+        ov_axes = update_coordinated_regs(r, ticks);
+      } else
+#endif
+      {
+#define UPDATE_AXIS(a) \
+        ov_axes |= update_axis_regs(r, a, r->rapid, ticks) ? (1<<a) : 0;
+        CNC_FOR_EACH_AXIS(UPDATE_AXIS)
+#undef UPDATE_AXIS
       }
-      machine.pipe_len--;
-      if (machine.pipe_cb) {
-        machine.pipe_cb(machine.cur_motion.id);
+    }
+
+    // control port setting, step pins high in first half of axis period
+    u32_t step_axes = 0;
+#ifdef CONFIG_CNC_BRESENHAM
+    u8_t dom = r->profile.dom;
+    if (r->profile.entry && r->step_count[dom] > 0) {
+      // step pins of coordinated motion rest high and drop in the second
+      // half of the dominant axis period for axes stepping at its end
+      step_axes = (1<<AXES_COUNT) - 1;
+      if (r->timer_counter[dom] > CNC_TIMER_HALF) {
+        step_axes &= ~machine.pulse_axes;
       }
+    } else
+#endif
+    {
+#define STEP_AXIS(a) \
+      step_axes |= r->timer_counter[a] <= CNC_TIMER_HALF ? (1<<a) : 0;
+      CNC_FOR_EACH_AXIS(STEP_AXIS)
+#undef STEP_AXIS
+    }
+
+    u32_t dir_axes = r->dir_axes;
+    u32_t set = 0;
+#define PORT_AXIS(a) \
+    set |= ((dir_axes & (1<<a)) ? axis_dir_pin[a] : 0) | \
+        ((step_axes & (1<<a)) ? axis_step_pin[a] : 0);
+    CNC_FOR_EACH_AXIS(PORT_AXIS)
+#undef PORT_AXIS
+    port_def(set, CNC_AXES_PINS & ~set);
+    machine.step_high = step_axes;
+
+    // position calculations, backlash take up does not move the machine
+    if (machine.take_up) {
+      ov_axes = 0;
+    }
+#define POS_AXIS(a) \
+    if (ov_axes & (1<<a)) { \
+      machine.pos[a] += (dir_axes & (1<<a)) ? 1 : -1; \
     }
+    CNC_FOR_EACH_AXIS(POS_AXIS)
+#undef POS_AXIS
   }
 
-  // motion latch
-  // something to latch, is there room for it in our pipe
-  if (machine.latch_registers && machine.pipe_len < CNC_PIPE_CAPACITY) {
-    copy_motion(&machine.pipe[machine.pipe_end], &machine.latch);
-    machine.pipe_end++;
-    if (machine.pipe_end >= CNC_PIPE_CAPACITY) {
-      machine.pipe_end = 0;
+  u32_t still = r->pause == 0;
+#define STILL_AXIS(a) \
+  still = still && r->step_count[a] == 0;
+  CNC_FOR_EACH_AXIS(STILL_AXIS)
+#undef STILL_AXIS
+  if (still != machine.still) {
+    // motion started or ended
+    machine.still = still;
+    machine.sr_dirty = TRUE;
+    if (still) {
+      machine.cur_ticks = 0;
+    }
+  }
+
+  if (machine.home_phase != CNC_HOMING_IDLE) {
+    // homing, pipe waits
+    if (still && !machine.motion_stop) {
+      home_next(r);
+    }
+  } else if (machine.pipe_active && still && !machine.motion_stop) {
+    // motion pipeline execution
+    // no current motion, something in the pipe?
+    u32_t start = machine.pipe_start;
+    if (machine.pipe_end != start) {
+      // see motion contents published with pipe end
+      CNC_PIPE_BARRIER();
+      CNC_Queued_t *q = &machine.pipe[start & CNC_PIPE_MASK];
+      if (load_take_up(q)) {
+        // motion stays in pipe until backlash is taken up
+      } else {
+        load_motion(q);
+        q->id = 0; // clear id of used motion
+        // release slot only when motion is read
+        CNC_PIPE_BARRIER();
+        machine.pipe_start = start + 1;
+        machine.sr_dirty = TRUE;
+        machine.pipe_running = TRUE;
+        machine.queue_ticks -= q->ticks;
+        machine.cur_ticks = q->ticks;
+        machine.pipe_stats.motions++;
+        machine.pipe_stats.min_depth =
+            MIN(machine.pipe_stats.min_depth, machine.pipe_end - (start + 1));
+#ifdef CONFIG_CNC_BRESENHAM
+        {
+          u32_t dom_total = r->step_total[r->profile.dom];
+#define BRES_AXIS(a) \
+          r->bres_err[a] = dom_total >> 1;
+          CNC_FOR_EACH_AXIS(BRES_AXIS)
+#undef BRES_AXIS
+          machine.pulse_axes = next_pulse_axes(r);
+        }
+#endif
+        if (machine.pipe_cb) {
+          machine.pipe_cb(r->id);
+        }
+      }
+    } else {
+      machine.speed = 0;
+      if (machine.pipe_running) {
+        // pipe ran empty, host did not keep up or stream ended
+        machine.pipe_running = FALSE;
+        machine.pipe_stats.underruns++;
+      }
     }
-    machine.pipe_len++;
-    machine.latch_registers = FALSE;
   }
 }
 
+void CNC_timer() {
+  cnc_timer_ticks(1);
+}
+
+#ifdef CONFIG_CNC_STEP_TIMER
+// ticks until axis timer counter crosses next step pin edge
+static u32_t axis_ticks_to_edge(const CNC_Regs_t *r, CNC_Axis_t a) {
+  u32_t inc = axis_inc(r, a);
+  u32_t c = r->timer_counter[a];
+  if (r->step_count[a] == 0 || inc == 0) {
+    return 0xffffffff;
+  }
+  if (c <= CNC_TIMER_HALF) {
+    return (CNC_TIMER_HALF - c) / inc + 1;
+  } else {
+    return (CNC_TIMER_FULL - c + inc - 1) / inc;
+  }
+}
+
+// ticks until next step pin change, polls at least each millisecond
+static u32_t ticks_to_next_event() {
+  const CNC_Regs_t *r = &machine.cur_motion;
+  u32_t ticks = CNC_TIMER_FREQ/1000;
+  if (r->pause > 0) {
+    return MAX(1, MIN(ticks, machine.pause_tick));
+  }
+#ifdef CONFIG_CNC_BRESENHAM
+  if (r->profile.entry) {
+    // minor axes only step with dominant axis
+    ticks = MIN(ticks, axis_ticks_to_edge(r, r->profile.dom));
+  } else
+#endif
+  {
+#define EDGE_AXIS(a) \
+    ticks = MIN(ticks, axis_ticks_to_edge(r, a));
+    CNC_FOR_EACH_AXIS(EDGE_AXIS)
+#undef EDGE_AXIS
+  }
+  return MAX(1, ticks);
+}
+
+u32_t CNC_step_timer() {
+  cnc_timer_ticks(machine.step_ticks);
+  machine.step_ticks = ticks_to_next_event();
+  return machine.step_ticks;
+}
+#endif
+
+#ifdef CONFIG_CNC_DMA_WAVE
+void CNC_wave_block(u32_t *dst, u32_t len) {
+  while (len--) {
+    // unless engine writes port this tick, leave port as is
+    machine.wave_word = 0;
+    cnc_timer_ticks(1);
+    *dst++ = machine.wave_word;
+  }
+}
+
+u32_t *CNC_wave_buffer() {
+  return &machine.wave_buf[0];
+}
+
+void CNC_wave_fill(u32_t half) {
+  CNC_wave_block(&machine.wave_buf[half ? CNC_WAVE_BLOCK : 0], CNC_WAVE_BLOCK);
+}
+#endif
+
 u32_t CNC_get_status() {
+  CNC_Regs_t *r = &machine.cur_motion;
   u32_t sr = 0;
+  u32_t pause = TIMER_REG(r->pause);
+  u32_t still = pause == 0;
+#define STILL_AXIS(a) \
+  still = still && TIMER_REG(r->step_count[a]) == 0;
+  CNC_FOR_EACH_AXIS(STILL_AXIS)
+#undef STILL_AXIS
   sr |= ((machine.cnc_timer_active ? 1 : 0) << CNC_STATUS_BIT_CONTROL_ENABLED);
-  sr |= ((machine.cur_motion.vector[X_AXIS].step_count == 0 &&
-      machine.cur_motion.vector[Y_AXIS].step_count == 0 &&
-      machine.cur_motion.vector[Z_AXIS].step_count  == 0 &&
-      machine.cur_motion.pause == 0 ? 1 : 0) << CNC_STATUS_BIT_MOVEMENT_STILL);
-  sr |= ((machine.cur_motion.pause != 0 ? 1 : 0) << CNC_STATUS_BIT_MOVEMENT_PAUSE);
-  sr |= ((machine.cur_motion.rapid ? 1 : 0) << CNC_STATUS_BIT_MOVEMENT_RAPID);
+  sr |= ((still ? 1 : 0) << CNC_STATUS_BIT_MOVEMENT_STILL);
+  sr |= ((pause != 0 ? 1 : 0) << CNC_STATUS_BIT_MOVEMENT_PAUSE);
+  sr |= ((TIMER_REG(r->rapid) ? 1 : 0) << CNC_STATUS_BIT_MOVEMENT_RAPID);
+  sr |= ((machine.feed_hold ? 1 : 0) << CNC_STATUS_BIT_FEED_HOLD);
+  sr |= ((machine.feed_hold && machine.feed_scale == 0 ? 1 : 0) << CNC_STATUS_BIT_FEED_HELD);
+  sr |= ((machine.home_phase != CNC_HOMING_IDLE ? 1 : 0) << CNC_STATUS_BIT_HOMING);
+  sr |= ((machine.homed ? 1 : 0) << CNC_STATUS_BIT_HOMED);
 
   sr |= ((machine.pipe_active ? 1 : 0) << CNC_STATUS_BIT_PIPE_ACTIVE);
-  sr |= ((machine.pipe_len == 0 ? 1 : 0) << CNC_STATUS_BIT_PIPE_EMPTY);
-  sr |= ((machine.pipe_len >= CNC_PIPE_CAPACITY ? 1 : 0) << CNC_STATUS_BIT_PIPE_FULL);
+  u32_t len = pipe_len();
+  sr |= ((len == 0 ? 1 : 0) << CNC_STATUS_BIT_PIPE_EMPTY);
+  sr |= ((len >= CNC_PIPE_CAPACITY ? 1 : 0) << CNC_STATUS_BIT_PIPE_FULL);
 
-  sr |= ((machine.latch_registers ? 1 : 0) << CNC_STATUS_BIT_LATCH_FULL);
+  // motions are latched directly into pipe, latch is full when pipe is or
+  // when an arc is still being fed
+  sr |= ((len >= CNC_PIPE_CAPACITY || machine.arc_active ? 1 : 0) << CNC_STATUS_BIT_LATCH_FULL);
 
   sr |= (machine.sr_err << 8) & 0xff00;
 
@@ -346,28 +1184,72 @@ u32_t CNC_get_status() {
 
 void CNC_set_enabled(u32_t enable) {
   machine.cnc_timer_active = enable;
+  machine.sr_dirty = TRUE;
+}
+
+u32_t CNC_set_feed_override(u32_t percent) {
+  machine.feed_override =
+      MAX(CNC_FEED_OVERRIDE_MIN, MIN(CNC_FEED_OVERRIDE_MAX, percent));
+  set_feed_target();
+  return machine.feed_override;
+}
+
+u32_t CNC_get_feed_override() {
+  return machine.feed_override;
+}
+
+void CNC_feed_hold(u32_t hold) {
+  machine.feed_hold = hold;
+  set_feed_target();
 }
 
 void CNC_pipeline_enable(u32_t enable) {
   machine.pipe_active = enable;
+  machine.sr_dirty = TRUE;
+}
+
+u32_t CNC_status_report(u32_t sr) {
+  u32_t report = ((machine.sr_reported ^ sr) & machine.sr_mask) != 0;
+  machine.sr_reported = sr;
+  return report;
+}
+
+void CNC_status_leds(u32_t sr) {
+  if ((sr >> 8) & machine.sr_err_mask) {
+    LED_disable(LED_CNC_WORK);
+    LED_blink_single(LED_CNC_DISABLE_BIT, 16, 3, LED_BLINK_FOREVER);
+    LED_blink(LED_ERROR1 | LED_ERROR2 | LED_ERROR3, 32, 20, LED_BLINK_FOREVER);
+    return;
+  }
+  LED_disable(LED_ERROR1 | LED_ERROR2 | LED_ERROR3);
+  if ((sr & (1<<CNC_STATUS_BIT_CONTROL_ENABLED)) == 0) {
+    LED_blink_single(LED_CNC_DISABLE_BIT, 16, 3, LED_BLINK_FOREVER);
+    LED_blink_single(LED_CNC_WORK_BIT, 64, 1, LED_BLINK_FOREVER);
+    return;
+  }
+  LED_disable(LED_CNC_DISABLE);
+  if (sr & ((1<<CNC_STATUS_BIT_MOVEMENT_PAUSE) | (1<<CNC_STATUS_BIT_FEED_HELD))) {
+    LED_blink_single(LED_CNC_WORK_BIT, 16, 8, LED_BLINK_FOREVER);
+  } else if (sr & (1<<CNC_STATUS_BIT_MOVEMENT_STILL)) {
+    LED_blink_single(LED_CNC_WORK_BIT, 16, 1, LED_BLINK_FOREVER);
+  } else {
+    LED_blink_single(LED_CNC_WORK_BIT, 16, 15, LED_BLINK_FOREVER);
+  }
 }
 
 u32_t CNC_is_latch_free() {
-  return (!machine.latch_registers);
+  return !machine.arc_active && pipe_len() < CNC_PIPE_CAPACITY;
 }
 
-static void set_latch_motion_regs_for_axis(CNC_Vector_t* pAxis, s32_t steps,
-    u32_t freq, u32_t rapid) {
-  pAxis->dir = steps > 0 ? 1 : 0;
+static void set_latch_motion_regs_for_axis(CNC_Queued_t *q, CNC_Axis_t axis_def,
+    s32_t steps, u32_t freq) {
+  if (steps > 0) {
+    q->flags |= (1<<axis_def);
+  }
   if (steps < 0) {
     steps = -steps;
   }
-  if (rapid) {
-    pAxis->step_count_half = steps >> 1;
-  }
-  pAxis->step_count = freq == 0 ? 0 : steps;
-  pAxis->step_freq = freq;
-  pAxis->step_freq_adj = 0;
+  q->steps[axis_def] = freq == 0 ? 0 : steps;
 }
 
 void CNC_set_latch_id(u32_t id) {
@@ -375,154 +1257,555 @@ void CNC_set_latch_id(u32_t id) {
 }
 
 u32_t CNC_get_current_motion_id() {
-  return machine.cur_motion.id;
+  return TIMER_REG(machine.cur_motion.id);
 }
 
 void CNC_get_motion(CNC_Motion_t* pMotion) {
-  copy_motion(pMotion, &machine.cur_motion);
+  const CNC_Regs_t *r = &machine.cur_motion;
+  int a;
+  // consistent snapshot of running registers
+  enter_critical();
+  pMotion->id = r->id;
+  for (a = 0; a < AXES_COUNT; a++) {
+    CNC_Vector_t *v = &pMotion->vector[a];
+    v->timer_counter = r->timer_counter[a];
+    v->step_freq = r->step_freq[a];
+    v->step_count = r->step_count[a];
+    v->ramp_steps = r->ramp_steps[a];
+    v->step_freq_adj = r->step_freq_adj[a];
+    v->step_factor = r->step_factor[a];
+    v->step_total = r->step_total[a];
+    v->bres_err = r->bres_err[a];
+    v->dir = (r->dir_axes & (1<<a)) != 0;
+  }
+  pMotion->pause = r->pause;
+  pMotion->rapid = r->rapid;
+  pMotion->profile = r->profile;
+  exit_critical();
+}
+
+// Re-estimates ticks of a motion waiting in pipe after its plan changed.
+// If timer has taken the motion meanwhile it has already been accounted.
+static void replan_ticks(CNC_Queued_t *q, u32_t seq) {
+  u32_t ticks = CNC_PLAN_ticks(q, &machine.config);
+  enter_critical();
+  if (seq - machine.pipe_start < pipe_len()) {
+    machine.queue_ticks += ticks - q->ticks;
+    q->ticks = ticks;
+  }
+  exit_critical();
+}
+
+// Slows a planned motion latched into a shallow pipe. The planner always
+// lets the machine stop within the queued motions, so a host not keeping up
+// makes the machine stop and start at each motion. Stretching motions while
+// the pipe is shallow turns starvation into slower motion instead.
+static void latch_slowdown(CNC_Queued_t *m) {
+  u32_t depth = machine.config.slow_depth;
+  u32_t len = pipe_len();
+  if (m->plan.length == 0 || len >= depth) {
+    return;
+  }
+  u32_t t = (u32_t)(((u64_t)machine.config.slow_time * (depth - len)) / depth);
+  if (t == 0) {
+    return;
+  }
+  u32_t v = (u32_t)MIN(0xffffffff, ((u64_t)m->plan.length * 1000000) / t);
+  if (v < m->plan.nominal) {
+    m->plan.nominal = MAX(1, v);
+    m->plan.floor = MIN(m->plan.floor, m->plan.nominal);
+    m->plan.max_entry = m->plan.floor;
+    m->plan.entry = m->plan.floor;
+    m->plan.exit = m->plan.floor;
+  }
+}
+
+// Plans latched motion against pipelined motions. The entry speed of the
+// pipe head is never changed as it is the exit speed of the current motion.
+// Entry and exit speeds only grow when motions are added, so if timer grabs
+// a motion while planning, it will at worst run it slower than planned.
+static void plan_pipe(CNC_Queued_t *m) {
+  u32_t end = machine.pipe_end;
+  u32_t start = machine.pipe_start;
+  u32_t len = end - start;
+  int o;
+
+  if (m->plan.length == 0) {
+    // unplanned motion, pipe will stop before this
+    return;
+  }
+  if (len == 0) {
+    return;
+  }
+
+  m->plan.max_entry = CNC_PLAN_junction(
+      &machine.pipe[(end - 1) & CNC_PIPE_MASK], m, &machine.config);
+  if (m->flags & CNC_QUEUED_BACKLASH) {
+    // backlash is taken up from standstill
+    m->plan.max_entry = m->plan.floor;
+  }
+
+  // backward pass, latched motion must be able to stop
+  u32_t exit = MIN(m->plan.max_entry,
+      CNC_PLAN_reach(&m->plan, m->plan.floor, m->plan.length));
+  m->plan.entry = exit;
+  for (o = len - 1; o > 0; o--) {
+    CNC_Queued_t *pm = &machine.pipe[(start + o) & CNC_PIPE_MASK];
+    if (pm->plan.length == 0) {
+      o++;
+      break;
+    }
+    u32_t entry = MIN(pm->plan.max_entry,
+        CNC_PLAN_reach(&pm->plan, exit, pm->plan.length));
+    if (entry == pm->plan.entry) {
+      // nothing changes before this
+      break;
+    }
+    pm->plan.entry = entry;
+    exit = entry;
+  }
+
+  // forward pass, from first affected motion
+  for (; o < len; o++) {
+    u32_t seq = start + o;
+    CNC_Queued_t *pm = &machine.pipe[seq & CNC_PIPE_MASK];
+    CNC_Queued_t *next = o + 1 < len ? &machine.pipe[(seq + 1) & CNC_PIPE_MASK] : m;
+    if (pm->plan.length == 0) {
+      continue;
+    }
+    u32_t reach = CNC_PLAN_reach(&pm->plan, pm->plan.entry, pm->plan.length);
+    if (next->plan.entry > reach) {
+      next->plan.entry = MAX(reach, next->plan.floor);
+    }
+    // single word, timer sees either old or new exit
+    pm->plan.exit = next->plan.entry;
+    replan_ticks(pm, seq);
+  }
+}
+
+// Returns free pipe slot, or NULL if pipe is full. The slot is not seen by
+// timer until committed.
+static CNC_Queued_t *pipe_slot() {
+  if (pipe_len() >= CNC_PIPE_CAPACITY) {
+    return NULL;
+  }
+  return &machine.pipe[machine.pipe_end & CNC_PIPE_MASK];
+}
+
+// Returns free pipe slot to latch into, or NULL if latch is busy
+static CNC_Queued_t *latch_slot() {
+  if (machine.arc_active) {
+    return NULL;
+  }
+  return pipe_slot();
+}
+
+// Hands latched slot over to timer
+static void latch_commit() {
+  CNC_Queued_t *m = &machine.pipe[machine.pipe_end & CNC_PIPE_MASK];
+  m->ticks = CNC_PLAN_ticks(m, &machine.config);
+  // motion contents must be visible before pipe end
+  CNC_PIPE_BARRIER();
+  // queue time is kept by timer too
+  enter_critical();
+  machine.pipe_end++;
+  machine.queue_ticks += m->ticks;
+  exit_critical();
+  machine.sr_dirty = TRUE;
+}
+
+// signed steps of a queued motion axis
+#define QUEUED_STEPS(q, a) (((q)->flags & (1<<(a))) ? (s32_t)(q)->steps[a] : -(s32_t)(q)->steps[a])
+
+// Advances latched end position and axis directions by queued motion
+static void latch_track(const CNC_Queued_t *q) {
+  u32_t moving = 0;
+  int a;
+  for (a = 0; a < AXES_COUNT; a++) {
+    machine.latch_pos[a] += QUEUED_STEPS(q, a);
+    moving |= q->steps[a] ? (1<<a) : 0;
+  }
+  machine.latch_dir = (machine.latch_dir & ~moving) | (q->flags & moving);
+}
+
+// Recalculates latched end position and axis directions from machine state
+// and what is left of current motion and pipe. Pipe slots are only written
+// by latching task, so only the timer side needs to be held off.
+static void latch_sync() {
+  const CNC_Regs_t *r = &machine.cur_motion;
+  u32_t seq;
+  int a;
+  enter_critical();
+  machine.latch_stale = FALSE;
+  seq = machine.pipe_start;
+  machine.latch_dir = machine.axis_dir;
+  for (a = 0; a < AXES_COUNT; a++) {
+    machine.latch_pos[a] = machine.pos[a];
+    if (!machine.take_up) {
+      machine.latch_pos[a] += (r->dir_axes & (1<<a)) ?
+          (s32_t)r->step_count[a] : -(s32_t)r->step_count[a];
+    }
+  }
+  exit_critical();
+  for (; seq != machine.pipe_end; seq++) {
+    latch_track(&machine.pipe[seq & CNC_PIPE_MASK]);
+  }
+}
+
+// Returns FALSE and sets soft limit error if any point within lo..hi steps
+// from latched end position is outside soft limits
+static bool latch_within_limits(const s32_t *lo, const s32_t *hi) {
+  const CNC_Config_t *cfg = &machine.config;
+  int a;
+  for (a = 0; a < AXES_COUNT; a++) {
+    if ((cfg->soft_limits & (1<<a)) &&
+        (machine.latch_pos[a] + lo[a] < cfg->soft_min[a] ||
+         machine.latch_pos[a] + hi[a] > cfg->soft_max[a])) {
+      CNC_enable_error(1<<CNC_ERROR_BIT_SOFT_LIMIT);
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+// Flags motion reversing an axis having backlash
+static void latch_backlash(CNC_Queued_t *m) {
+  if (backlash_axes(m, machine.latch_dir)) {
+    m->flags |= CNC_QUEUED_BACKLASH;
+  }
+}
+
+u32_t CNC_latch(const s32_t *steps, const u32_t *freq, u32_t rapid) {
+  CNC_Queued_t *m = latch_slot();
+  int a;
+  if (m == NULL) {
+    return CNC_ERR_LATCH_BUSY;
+  }
+  m->flags = rapid ? CNC_QUEUED_RAPID : 0;
+  for (a = 0; a < AXES_COUNT; a++) {
+    set_latch_motion_regs_for_axis(m, a, steps[a], freq[a]);
+  }
+  if (machine.latch_stale) {
+    latch_sync();
+  }
+  if (machine.config.soft_limits) {
+    // end of a straight motion is its farthest point
+    s32_t end[AXES_COUNT];
+    for (a = 0; a < AXES_COUNT; a++) {
+      end[a] = QUEUED_STEPS(m, a);
+    }
+    if (!latch_within_limits(end, end)) {
+      return CNC_ERR_LATCH_LIMIT;
+    }
+  }
+  m->id = machine.latch_id++;
+  // other axes run proportionally to dominant axis
+  m->rate = freq[CNC_PLAN_dominant(m)];
+  latch_backlash(m);
+  CNC_PLAN_motion(m, &machine.config);
+  latch_slowdown(m);
+  plan_pipe(m);
+  latch_track(m);
+
+  latch_commit();
+
+  return m->id;
 }
 
 u32_t CNC_latch_xyz(s32_t stepsX, u32_t freqX, s32_t stepsY, u32_t freqY, s32_t stepsZ,
     u32_t freqZ, u32_t rapid) {
-  if (!CNC_is_latch_free()) {
+  s32_t steps[AXES_COUNT] = {stepsX, stepsY, stepsZ};
+  u32_t freq[AXES_COUNT] = {freqX, freqY, freqZ};
+  return CNC_latch(steps, freq, rapid);
+}
+
+u32_t CNC_latch_pause(u32_t timeInMs) {
+  CNC_Queued_t *m = latch_slot();
+  if (m == NULL) {
     return CNC_ERR_LATCH_BUSY;
   }
-  machine.latch.id = machine.latch_id++;
-  machine.latch.rapid = rapid;
-  set_latch_motion_regs_for_axis(&machine.latch.vector[X_AXIS], stepsX, freqX, rapid);
-  set_latch_motion_regs_for_axis(&machine.latch.vector[Y_AXIS], stepsY, freqY, rapid);
-  set_latch_motion_regs_for_axis(&machine.latch.vector[Z_AXIS], stepsZ, freqZ, rapid);
-  machine.latch.pause = 0;
+  m->id = machine.latch_id++;
+  m->flags = CNC_QUEUED_PAUSE;
+  memset(m->steps, 0, sizeof(m->steps));
+  m->rate = timeInMs == 0 ? 0 : 1 + timeInMs;
+  CNC_PLAN_motion(m, &machine.config);
 
-  machine.latch_registers = TRUE;
+  latch_commit();
 
-  return machine.latch.id;
+  return m->id;
 }
 
-u32_t CNC_latch_pause(u32_t timeInMs) {
-  if (!CNC_is_latch_free()) {
+// signed steps of a motion axis
+#define AXIS_STEPS(v) ((v)->dir ? (s32_t)(v)->step_count : -(s32_t)(v)->step_count)
+
+u32_t CNC_latch_batch(const CNC_Motion_t *m, u32_t n, u32_t *pFirstId) {
+  u32_t i;
+  for (i = 0; i < n; i++, m++) {
+    u32_t id;
+    if (!CNC_is_latch_free()) {
+      break;
+    }
+    if (m->pause > 0) {
+      id = CNC_latch_pause(m->pause);
+    } else {
+      s32_t steps[AXES_COUNT];
+      u32_t freq[AXES_COUNT];
+      int a;
+      for (a = 0; a < AXES_COUNT; a++) {
+        steps[a] = AXIS_STEPS(&m->vector[a]);
+        freq[a] = m->vector[a].step_freq;
+      }
+      id = CNC_latch(steps, freq, m->rapid);
+    }
+    if (i == 0 && pFirstId) {
+      *pFirstId = id;
+    }
+    if (id == (u32_t)CNC_ERR_LATCH_LIMIT) {
+      break;
+    }
+  }
+  return i;
+}
+
+// Latches arc segments until arc is done or pipe is full
+static void arc_feed() {
+  CNC_Queued_t *m;
+  s32_t d0, d1;
+  while (machine.arc_active && (m = pipe_slot()) != NULL) {
+    if (!CNC_ARC_next(&machine.arc, &d0, &d1)) {
+      machine.arc_active = FALSE;
+      machine.sr_dirty = TRUE;
+      break;
+    }
+    m->id = machine.arc_id;
+    m->flags = 0;
+    memset(m->steps, 0, sizeof(m->steps));
+    set_latch_motion_regs_for_axis(m, machine.arc_axes[0], d0, 1);
+    set_latch_motion_regs_for_axis(m, machine.arc_axes[1], d1, 1);
+    // dominant axis rate giving arc feed along the segment
+    u32_t len = CNC_PLAN_sqrt((u64_t)((s64_t)d0 * d0) + (u64_t)((s64_t)d1 * d1));
+    m->rate = (u32_t)(((u64_t)machine.arc_feed * m->steps[CNC_PLAN_dominant(m)]) / MAX(1, len));
+    if (machine.latch_stale) {
+      latch_sync();
+    }
+    latch_backlash(m);
+    CNC_PLAN_motion(m, &machine.config);
+    latch_slowdown(m);
+    plan_pipe(m);
+    latch_track(m);
+
+    latch_commit();
+  }
+}
+
+u32_t CNC_latch_arc(u32_t plane, s32_t c0, s32_t c1, s32_t e0, s32_t e1,
+    u32_t ccw, u32_t feed) {
+  static const u8_t plane_axes[3][2] = {
+      {X_AXIS, Y_AXIS}, {X_AXIS, Z_AXIS}, {Y_AXIS, Z_AXIS}
+  };
+  if (plane > CNC_ARC_PLANE_YZ || feed == 0 || (c0 == 0 && c1 == 0)) {
+    return CNC_ERR_LATCH_ARG;
+  }
+  if (latch_slot() == NULL) {
     return CNC_ERR_LATCH_BUSY;
   }
-  machine.latch.id = machine.latch_id++;
-  set_latch_motion_regs_for_axis(&machine.latch.vector[X_AXIS], 0, 0, 0);
-  set_latch_motion_regs_for_axis(&machine.latch.vector[Y_AXIS], 0, 0, 0);
-  set_latch_motion_regs_for_axis(&machine.latch.vector[Z_AXIS], 0, 0, 0);
-  machine.latch.pause = timeInMs == 0 ? 0 : 1 + timeInMs;
-  machine.latch_registers = TRUE;
+  CNC_ARC_init(&machine.arc, c0, c1, e0, e1, ccw, machine.config.arc_tolerance);
+  if (machine.latch_stale) {
+    latch_sync();
+  }
+  if (machine.config.soft_limits) {
+    s32_t lo[AXES_COUNT] = {0};
+    s32_t hi[AXES_COUNT] = {0};
+    s32_t arc_lo[2], arc_hi[2];
+    CNC_ARC_bounds(&machine.arc, arc_lo, arc_hi);
+    lo[plane_axes[plane][0]] = arc_lo[0];
+    lo[plane_axes[plane][1]] = arc_lo[1];
+    hi[plane_axes[plane][0]] = arc_hi[0];
+    hi[plane_axes[plane][1]] = arc_hi[1];
+    if (!latch_within_limits(lo, hi)) {
+      return CNC_ERR_LATCH_LIMIT;
+    }
+  }
+  machine.arc_axes[0] = plane_axes[plane][0];
+  machine.arc_axes[1] = plane_axes[plane][1];
+  machine.arc_feed = feed;
+  machine.arc_id = machine.latch_id++;
+  machine.arc_active = TRUE;
+  machine.sr_dirty = TRUE;
+  arc_feed();
+  return machine.arc_id;
+}
 
-  return machine.latch.id;
+void CNC_pipeline_feed() {
+  arc_feed();
 }
 
-static void set_imm_motion_regs_for_axis(CNC_Vector_t* pAxis,
-    s32_t steps, u32_t freq) {
-  pAxis->dir = steps > 0 ? 1 : 0;
-  if (steps < 0) {
+u32_t CNC_pipeline_feed_pending() {
+  return machine.arc_active;
+}
+
+// sets axis of current motion, called with timer held off
+static void set_imm_motion_regs_for_axis(CNC_Axis_t a, s32_t steps, u32_t freq) {
+  CNC_Regs_t *r = &machine.cur_motion;
+  r->rapid = FALSE;
+  r->profile.entry = 0;
+  if (steps > 0) {
+    r->dir_axes |= (1<<a);
+    machine.axis_dir |= (1<<a);
+  } else {
+    r->dir_axes &= ~(1<<a);
+    if (steps < 0) {
+      machine.axis_dir &= ~(1<<a);
+    }
     steps = -steps;
   }
-  pAxis->step_count = steps;
-  pAxis->step_freq = freq;
-  pAxis->step_freq_adj = 0;
+  r->step_count[a] = steps;
+  r->step_total[a] = steps;
+  r->step_freq[a] = freq;
+  r->step_freq_adj[a] = 0;
+  r->step_factor[a] = 0;
+  // overwrites any backlash take up, these steps move the machine
+  machine.take_up = FALSE;
+  machine.latch_stale = TRUE;
+#ifdef CONFIG_CNC_STEP_TIMER
+  // step timer sleeps until its scheduled event, motion starts from there
+  machine.step_ticks = 1;
+#endif
 }
 
 void CNC_pipeline_flush() {
-  int oldActive = machine.cnc_timer_active;
-  machine.cnc_timer_active = FALSE;
-  machine.pipe_len = 0;
+  // both pipe ends are reset, so keep timer out
+  enter_critical();
+  if (machine.take_up) {
+    // backlash take up of the motion at pipe head goes with it
+    drop_motion(&machine.cur_motion);
+  }
   machine.pipe_start = 0;
   machine.pipe_end = 0;
+  machine.arc_active = FALSE;
   memset(&machine.pipe, 0, sizeof(machine.pipe) >> 1);
-  memset(&machine.latch, 0, sizeof(machine.latch) >> 1);
-  machine.latch_registers = FALSE;
-  machine.cnc_timer_active = oldActive;
+  machine.latch_stale = TRUE;
+  machine.pipe_running = FALSE;
+  machine.queue_ticks = 0;
+  machine.sr_dirty = TRUE;
+  exit_critical();
+}
+
+u32_t CNC_get_queue_time() {
+  u64_t ticks;
+  enter_critical();
+  ticks = machine.queue_ticks + machine.cur_ticks;
+  exit_critical();
+  // kept at full feed
+  return (u32_t)MIN(0xffffffff, (ticks * 100) / machine.feed_override);
+}
+
+void CNC_get_pipe_stats(CNC_Pipe_stats_t *stats, u32_t reset) {
+  enter_critical();
+  *stats = machine.pipe_stats;
+  if (reset) {
+    reset_pipe_stats();
+  }
+  exit_critical();
 }
 
 void CNC_set_x_imm(s32_t stepsX, u32_t freqX) {
-  machine.cur_motion.rapid = FALSE;
-  set_imm_motion_regs_for_axis(&machine.cur_motion.vector[X_AXIS], stepsX, freqX);
+  enter_critical();
+  set_imm_motion_regs_for_axis(X_AXIS, stepsX, freqX);
+  machine.feed_ramp = feed_ramp(&machine.cur_motion);
+  machine.sr_dirty = TRUE;
+  exit_critical();
 }
 
 void CNC_set_y_imm(s32_t stepsY, u32_t freqY) {
-  machine.cur_motion.rapid = FALSE;
-  set_imm_motion_regs_for_axis(&machine.cur_motion.vector[Y_AXIS], stepsY, freqY);
+  enter_critical();
+  set_imm_motion_regs_for_axis(Y_AXIS, stepsY, freqY);
+  machine.feed_ramp = feed_ramp(&machine.cur_motion);
+  machine.sr_dirty = TRUE;
+  exit_critical();
 }
 
 void CNC_set_z_imm(s32_t stepsZ, u32_t freqZ) {
-  machine.cur_motion.rapid = FALSE;
-  set_imm_motion_regs_for_axis(&machine.cur_motion.vector[Z_AXIS], stepsZ, freqZ);
+  enter_critical();
+  set_imm_motion_regs_for_axis(Z_AXIS, stepsZ, freqZ);
+  machine.feed_ramp = feed_ramp(&machine.cur_motion);
+  machine.sr_dirty = TRUE;
+  exit_critical();
+}
+
+void CNC_set_imm(const s32_t *steps, const u32_t *freq) {
+  int a;
+  enter_critical();
+  for (a = 0; a < AXES_COUNT; a++) {
+    set_imm_motion_regs_for_axis(a, steps[a], freq[a]);
+  }
+  machine.feed_ramp = feed_ramp(&machine.cur_motion);
+  machine.sr_dirty = TRUE;
+  exit_critical();
 }
 
 void CNC_set_regs_imm(s32_t stepsX, u32_t freqX, s32_t stepsY, u32_t freqY, s32_t stepsZ, u32_t freqZ) {
-  machine.cur_motion.rapid = FALSE;
-  set_imm_motion_regs_for_axis(&machine.cur_motion.vector[X_AXIS], stepsX, freqX);
-  set_imm_motion_regs_for_axis(&machine.cur_motion.vector[Y_AXIS], stepsY, freqY);
-  set_imm_motion_regs_for_axis(&machine.cur_motion.vector[Z_AXIS], stepsZ, freqZ);
+  s32_t steps[AXES_COUNT] = {stepsX, stepsY, stepsZ};
+  u32_t freq[AXES_COUNT] = {freqX, freqY, freqZ};
+  CNC_set_imm(steps, freq);
 }
 
-void CNC_get_pos(s32_t* px, s32_t* py, s32_t* pz) {
-  if (px != NULL) {
-    *px = machine.pos_x + machine.offs_pos_x;
-  }
-  if (py != NULL) {
-    *py = machine.pos_y + machine.offs_pos_y;
+void CNC_get_pos(s32_t *pos) {
+  int a;
+  for (a = 0; a < AXES_COUNT; a++) {
+    pos[a] = machine.pos[a] + machine.offs_pos[a];
   }
-  if (pz != NULL) {
-    *pz = machine.pos_z + machine.offs_pos_z;
+}
+
+void CNC_get_machine_pos(s32_t *pos) {
+  int a;
+  // snapshot all axes at once
+  enter_critical();
+  for (a = 0; a < AXES_COUNT; a++) {
+    pos[a] = machine.pos[a];
   }
+  exit_critical();
 }
 
-void CNC_set_pos(s32_t x, s32_t y, s32_t z) {
-  int oldActive = machine.cnc_timer_active;
-  machine.cnc_timer_active = FALSE;
-  machine.pos_x = x;
-  machine.pos_y = y;
-  machine.pos_z = z;
+void CNC_set_pos(const s32_t *pos) {
+  CNC_config_pos(pos);
   if (machine.pos_cb) {
-    machine.pos_cb(x,y,z);
+    machine.pos_cb(pos);
   }
-
-  machine.cnc_timer_active = oldActive;
 }
 
-void CNC_set_offs_pos(s32_t x, s32_t y, s32_t z) {
-  int oldActive = machine.cnc_timer_active;
-  machine.cnc_timer_active = FALSE;
-  machine.offs_pos_x = x;
-  machine.offs_pos_y = y;
-  machine.offs_pos_z = z;
+void CNC_set_offs_pos(const s32_t *pos) {
+  CNC_config_offs_pos(pos);
   if (machine.offs_cb) {
-    machine.offs_cb(x,y,z);
+    machine.offs_cb(pos);
   }
-
-  machine.cnc_timer_active = oldActive;
 }
 
-void CNC_config_pos(s32_t x, s32_t y, s32_t z) {
+void CNC_config_pos(const s32_t *pos) {
   int oldActive = machine.cnc_timer_active;
+  int a;
   machine.cnc_timer_active = FALSE;
-  machine.pos_x = x;
-  machine.pos_y = y;
-  machine.pos_z = z;
+  for (a = 0; a < AXES_COUNT; a++) {
+    machine.pos[a] = pos[a];
+  }
+  machine.latch_stale = TRUE;
   machine.cnc_timer_active = oldActive;
 }
 
-void CNC_config_offs_pos(s32_t x, s32_t y, s32_t z) {
+void CNC_config_offs_pos(const s32_t *pos) {
   int oldActive = machine.cnc_timer_active;
+  int a;
   machine.cnc_timer_active = FALSE;
-  machine.offs_pos_x = x;
-  machine.offs_pos_y = y;
-  machine.offs_pos_z = z;
+  for (a = 0; a < AXES_COUNT; a++) {
+    machine.offs_pos[a] = pos[a];
+  }
   machine.cnc_timer_active = oldActive;
 }
 
-void CNC_get_offs_pos(s32_t* px, s32_t* py, s32_t* pz) {
-  if (px != NULL) {
-    *px = machine.offs_pos_x;
-  }
-  if (py != NULL) {
-    *py =  machine.offs_pos_y;
-  }
-  if (pz != NULL) {
-    *pz = machine.offs_pos_z;
+void CNC_get_offs_pos(s32_t *pos) {
+  int a;
+  for (a = 0; a < AXES_COUNT; a++) {
+    pos[a] = machine.offs_pos[a];
   }
 }
 
@@ -537,27 +1820,83 @@ void CNC_set_error_mask(u32_t mask) {
 void CNC_enable_error(u32_t error) {
   DBG(D_APP, D_FATAL, "CNC_ERROR: %08b\n", error);
   machine.sr_err |= error;
+  machine.sr_dirty = TRUE;
 }
 
 void CNC_disable_error(u32_t error) {
   machine.sr_err &= ~error;
+  machine.sr_dirty = TRUE;
 }
 
-void CNC_set_probe(u32_t enabled, u32_t contactCount, u32_t probeZFreqOnTouch) {
-  if (enabled) {
-    machine.probe_status = CNC_PROBE_NOCONTACT;
-    machine.probe_count = contactCount;
-    machine.cur_probe_count = 0;
-    machine.probe_z_freq_on_touch = probeZFreqOnTouch;
-  } else {
-    machine.probe_status = CNC_PROBE_DISABLED;
-  }
+void CNC_set_probe(u32_t enabled) {
+#ifdef CONFIG_CNC_DMA_WAVE
+  // engine runs ahead of the port by up to two wave blocks, position at
+  // contact is unknown
+  (void)enabled;
+  machine.probe_status = CNC_PROBE_DISABLED;
+#else
+  machine.probe_status = enabled ? CNC_PROBE_NOCONTACT : CNC_PROBE_DISABLED;
+#endif
 }
 
 u32_t CNC_get_probe_status() {
   return machine.probe_status;
 }
 
+void CNC_get_probe_pos(s32_t *pos) {
+  int a;
+  for (a = 0; a < AXES_COUNT; a++) {
+    pos[a] = machine.probe_pos[a] + machine.offs_pos[a];
+  }
+}
+
+u32_t CNC_home(u32_t axes) {
+  u32_t res = FALSE;
+  enter_critical();
+  if (machine.home_phase == CNC_HOMING_IDLE) {
+    machine.home_axes = axes & ((1<<AXES_COUNT) - 1);
+    machine.homed = FALSE;
+    machine.home_phase = CNC_HOMING_NEXT;
+    machine.sr_dirty = TRUE;
+    res = TRUE;
+  }
+  exit_critical();
+  return res;
+}
+
+void CNC_limit_irq(CNC_Axis_t a) {
+  u32_t phase = machine.home_phase;
+  if (a != machine.home_axis || machine.home_edge ||
+      (phase != CNC_HOMING_SEEK && phase != CNC_HOMING_LOCATE)) {
+    // not seeking this switch, or bounce
+    return;
+  }
+  machine.home_edge_pos = machine.pos[a];
+  machine.home_edge = TRUE;
+  // homing ramp stops the axis
+  machine.motion_stop = TRUE;
+}
+
+void CNC_probe_irq() {
+  s32_t pos[AXES_COUNT];
+  int a;
+  if (machine.probe_status != CNC_PROBE_NOCONTACT) {
+    // not armed or bounce after contact
+    return;
+  }
+  // engine cannot run meanwhile, position is where the last step left it
+  for (a = 0; a < AXES_COUNT; a++) {
+    machine.probe_pos[a] = machine.pos[a];
+  }
+  machine.probe_status = CNC_PROBE_CONTACT;
+  machine.motion_stop = TRUE;
+  set_feed_target();
+  if (machine.probe_cb) {
+    CNC_get_probe_pos(pos);
+    machine.probe_cb(pos);
+  }
+}
+
 #define NIBBLES_CNC_DEC_HI ((32-CNC_FP_DECIMALS+3) / 4)
 #define NIBBLES_CNC_DEC_LO ((CNC_FP_DECIMALS+3) / 4)
 #define VEC_OUTPUT_STR "%s %c dir:%c steps:%8i f:%0_x.%0_x (%i Hz)\n"
@@ -578,45 +1917,146 @@ static void print_vector(const char *prefix, const char vec_prefix, CNC_Vector_t
               hz);
 }
 
+static const char axis_name[] = "XYZA";
+
+static void print_queued(CNC_Queued_t *q, u32_t ix) {
+  int a;
+  print("CNC pipe %3i id:%08x flags:%08b rate:%08x steps", ix,
+      q->id, q->flags, q->rate);
+  for (a = 0; a < AXES_COUNT; a++) {
+    print(" %c:%i", axis_name[a], q->steps[a]);
+  }
+  print("\n");
+  if (q->plan.length) {
+    print("CNC pipe %3i plan len:%i nom:%i entry:%i/%i exit:%i\n", ix,
+        q->plan.length, q->plan.nominal, q->plan.entry, q->plan.max_entry, q->plan.exit);
+  }
+}
+
 static void print_motion(CNC_Motion_t *motion, const char *prefix) {
   print("%s id:%08x pause:%i rapid:%i\n", prefix, motion->id, motion->pause, motion->rapid);
-  print_vector(prefix, 'X', &motion->vector[X_AXIS]);
-  print_vector(prefix, 'Y', &motion->vector[Y_AXIS]);
-  print_vector(prefix, 'Z', &motion->vector[Z_AXIS]);
+  int a;
+  for (a = 0; a < AXES_COUNT; a++) {
+    print_vector(prefix, axis_name[a], &motion->vector[a]);
+  }
+  if (motion->profile.entry) {
+    print("%s prof entry:%i exit:%i nom:%i acc:%i/tick decel@%i\n", prefix,
+        motion->profile.entry >> CNC_FP_DECIMALS, motion->profile.exit >> CNC_FP_DECIMALS,
+        motion->profile.nominal >> CNC_FP_DECIMALS, motion->profile.acc_tick,
+        motion->profile.decel_steps);
+  }
 }
 
 u32_t CNC_dump() {
   print("CNC\n---\n");
-  print("  active:%s sr:%16b report_mask:%08b\n", machine.cnc_timer_active ? "YES":"NO ", CNC_get_status(), machine.sr_mask);
+  print("  active:%s sr:%24b report_mask:%08b\n", machine.cnc_timer_active ? "YES":"NO ", CNC_get_status(), machine.sr_mask);
   print("  errors:%08b mask:%08b\n", machine.sr_err & machine.sr_err_mask, machine.sr_err_mask);
-  print("  config max_f x:%i y:%i z:%i\n", machine.config.max_freq[X_AXIS],
-      machine.config.max_freq[Y_AXIS], machine.config.max_freq[Z_AXIS]);
-  print("         rap_d x:%08x y:%08x z:%08x\n", machine.config.rapid_delta[X_AXIS],
-      machine.config.rapid_delta[Y_AXIS], machine.config.rapid_delta[Z_AXIS]);
-  print(" actual  x:%i y:%i z:%i\n", machine.pos_x, machine.pos_y, machine.pos_z);
-  print(" offset  x:%i y:%i z:%i\n", machine.offs_pos_x, machine.offs_pos_y, machine.offs_pos_z);
-  print(" current x:%i y:%i z:%i\n", machine.pos_x + machine.offs_pos_x, machine.pos_y + machine.offs_pos_y, machine.pos_z + machine.offs_pos_z);
-  print_motion(&machine.cur_motion, "CNC curr motion");
-  print(" pipe active:%s len:%i/%i\n", machine.pipe_active ? "YES" : "NO ",
-      machine.pipe_len, CNC_PIPE_CAPACITY);
+  int a;
+  for (a = 0; a < AXES_COUNT; a++) {
+    print("  config %c max_f:%i rap_acc:%i acc:%i start:%i jerk:%i\n", axis_name[a],
+        machine.config.max_freq[a], machine.config.rapid_acc[a], machine.config.acc[a],
+        machine.config.start_freq[a], machine.config.jerk[a]);
+  }
+  print("         junction deviation:%i/1000\n", machine.config.junction_dev);
+  print("         arc tolerance:%i/1000\n", machine.config.arc_tolerance);
+  for (a = 0; a < AXES_COUNT; a++) {
+    print("  home %c   seek:%i locate:%i backoff:%i travel:%i dir:%c\n", axis_name[a],
+        machine.config.home_seek[a], machine.config.home_locate[a],
+        machine.config.home_backoff[a], machine.config.home_travel[a],
+        (machine.config.home_dir & (1<<a)) ? '+' : '-');
+  }
+  for (a = 0; a < AXES_COUNT; a++) {
+    print("  backlash %c steps:%i freq:%i\n", axis_name[a],
+        machine.config.backlash[a], machine.config.backlash_freq[a]);
+  }
+  print("  homing  phase:%i axis:%c homed:%s\n", machine.home_phase,
+      axis_name[machine.home_axis], machine.homed ? "YES" : "NO ");
+  for (a = 0; a < AXES_COUNT; a++) {
+    print("  limit %c  %s min:%i max:%i\n", axis_name[a],
+        (machine.config.soft_limits & (1<<a)) ? "on " : "off",
+        machine.config.soft_min[a], machine.config.soft_max[a]);
+  }
+  print(" speed   %i\n", machine.speed >> CNC_FP_DECIMALS);
+  print(" dir     %04b take up:%s\n", machine.axis_dir, machine.take_up ? "YES" : "NO ");
+  print(" feed    override:%i%% hold:%s scale:%i%% ramp:%i/tick\n", machine.feed_override,
+      machine.feed_hold ? "YES" : "NO ", (u32_t)(((u64_t)machine.feed_scale * 100) >> CNC_FEED_Q),
+      machine.feed_ramp);
+  for (a = 0; a < AXES_COUNT; a++) {
+    print(" pos %c   actual:%i offset:%i current:%i\n", axis_name[a],
+        machine.pos[a], machine.offs_pos[a], machine.pos[a] + machine.offs_pos[a]);
+  }
+  if (machine.probe_status != CNC_PROBE_DISABLED) {
+    for (a = 0; a < AXES_COUNT; a++) {
+      print(" probe %c %s:%i\n", axis_name[a],
+          machine.probe_status == CNC_PROBE_CONTACT ? "contact" : "armed  ",
+          machine.probe_pos[a]);
+    }
+  }
+  CNC_Motion_t cur;
+  CNC_get_motion(&cur);
+  print_motion(&cur, "CNC curr motion");
+  u32_t start = machine.pipe_start;
+  u32_t len = machine.pipe_end - start;
+  print(" pipe active:%s len:%i/%i ram:%i bytes (%i/motion)\n", machine.pipe_active ? "YES" : "NO ",
+      len, CNC_PIPE_CAPACITY, sizeof(machine.pipe), sizeof(CNC_Queued_t));
+  print(" pipe stats underruns:%i min depth:%i motions:%i slow depth:%i time:%ius\n",
+      machine.pipe_stats.underruns, machine.pipe_stats.min_depth, machine.pipe_stats.motions,
+      machine.config.slow_depth, machine.config.slow_time);
   int i;
-  char pre[sizeof("CNC pipemotionX\0")];
-  memcpy(pre, "CNC pipemotionX\0", sizeof("CNC pipemotionX\0"));
-  for (i = 0; i < machine.pipe_len; i++) {
-    int ix = machine.pipe_start + i;
-    if (ix >= CNC_PIPE_CAPACITY) ix -= CNC_PIPE_CAPACITY;
-    pre[sizeof("CNC pipemotion") - 1] = '1' + i;
-    print_motion(&machine.pipe[ix], pre);
-  }
-  print(" latch:%s\n", machine.latch_registers ? "YES" : "NO ");
-  if (machine.latch_registers) {
-    print_motion(&machine.latch, "CNC latchmotion");
+  for (i = 0; i < len; i++) {
+    print_queued(&machine.pipe[(start + i) & CNC_PIPE_MASK], i);
   }
   return 0;
 }
 
-void CNC_set_config(CNC_Config_t *config) {
-  // TODO
+#ifdef CONFIG_CNC_TRACE
+u32_t CNC_trace_read(CNC_Trace_t *dst, u32_t max) {
+  u32_t rd = machine.trace_rd;
+  u32_t n = 0;
+  while (n < max && rd != machine.trace_wr) {
+    CNC_PIPE_BARRIER();
+    dst[n++] = machine.trace[rd & (CNC_TRACE_LEN - 1)];
+    rd++;
+  }
+  CNC_PIPE_BARRIER();
+  machine.trace_rd = rd;
+  return n;
+}
+
+u32_t CNC_trace_clear() {
+  enter_critical();
+  machine.tick = 0;
+  machine.trace_last = 0;
+  machine.trace_lost = 0;
+  machine.trace_rd = machine.trace_wr;
+  exit_critical();
+  return 0;
+}
+
+u32_t CNC_trace_dump() {
+  CNC_Trace_t t;
+  print("CNC trace, lost:%i\n", machine.trace_lost);
+  while (CNC_trace_read(&t, 1)) {
+    print("%10i %08x\n", t.tick, t.bsrr);
+  }
+  return 0;
+}
+#endif
+
+void CNC_set_config(const CNC_Config_t *config) {
+  int a;
+  machine.config = *config;
+  // same limits as when set one by one
+  for (a = 0; a < AXES_COUNT; a++) {
+    machine.config.max_freq[a] = MIN(config->max_freq[a], CNC_STEP_FREQ_LIMIT);
+    machine.config.home_seek[a] = MIN(config->home_seek[a], CNC_STEP_FREQ_LIMIT);
+    machine.config.home_locate[a] = MIN(config->home_locate[a], CNC_STEP_FREQ_LIMIT);
+    machine.config.backlash_freq[a] = MIN(config->backlash_freq[a], CNC_STEP_FREQ_LIMIT);
+    set_rapid_ramp(a);
+  }
+  machine.config.soft_limits &= (1<<AXES_COUNT) - 1;
+  machine.config.slow_depth = MIN(config->slow_depth, CNC_PIPE_CAPACITY);
+  machine.latch_stale = TRUE;
 }
 
 CNC_Config_t *CNC_get_config() {
@@ -624,24 +2064,72 @@ CNC_Config_t *CNC_get_config() {
 }
 
 void CNC_set_config_specific(u8_t config, u32_t value) {
+  u32_t a = (config & COMM_PROTOCOL_CONFIG_AXIS_MASK) - 1;
+  if ((config & ~COMM_PROTOCOL_CONFIG_AXIS_MASK) != COMM_PROTOCOL_CONFIG_GLOBAL &&
+      a < AXES_COUNT) {
+    switch (config & ~COMM_PROTOCOL_CONFIG_AXIS_MASK) {
+    case COMM_PROTOCOL_CONFIG_MAX_FREQ:
+      machine.config.max_freq[a] = MIN(value, CNC_STEP_FREQ_LIMIT);
+      break;
+    case COMM_PROTOCOL_CONFIG_RAPID_ACC:
+      machine.config.rapid_acc[a] = value;
+      set_rapid_ramp(a);
+      break;
+    case COMM_PROTOCOL_CONFIG_ACC:
+      machine.config.acc[a] = value;
+      break;
+    case COMM_PROTOCOL_CONFIG_START_FREQ:
+      machine.config.start_freq[a] = value;
+      break;
+    case COMM_PROTOCOL_CONFIG_JERK:
+      machine.config.jerk[a] = value;
+      break;
+    case COMM_PROTOCOL_CONFIG_HOME_SEEK:
+      machine.config.home_seek[a] = MIN(value, CNC_STEP_FREQ_LIMIT);
+      break;
+    case COMM_PROTOCOL_CONFIG_HOME_LOCATE:
+      machine.config.home_locate[a] = MIN(value, CNC_STEP_FREQ_LIMIT);
+      break;
+    case COMM_PROTOCOL_CONFIG_HOME_BACKOFF:
+      machine.config.home_backoff[a] = value;
+      break;
+    case COMM_PROTOCOL_CONFIG_HOME_TRAVEL:
+      machine.config.home_travel[a] = value;
+      break;
+    case COMM_PROTOCOL_CONFIG_BACKLASH:
+      machine.config.backlash[a] = value;
+      break;
+    case COMM_PROTOCOL_CONFIG_BACKLASH_FREQ:
+      machine.config.backlash_freq[a] = MIN(value, CNC_STEP_FREQ_LIMIT);
+      break;
+    case COMM_PROTOCOL_CONFIG_SOFT_MIN:
+      machine.config.soft_min[a] = (s32_t)value;
+      break;
+    case COMM_PROTOCOL_CONFIG_SOFT_MAX:
+      machine.config.soft_max[a] = (s32_t)value;
+      break;
+    }
+    return;
+  }
   switch (config) {
-  case COMM_PROTOCOL_CONFIG_MAX_X_FREQ:
-    machine.config.max_freq[X_AXIS] = value;
+  case COMM_PROTOCOL_CONFIG_JUNCTION_DEV:
+    machine.config.junction_dev = value;
     break;
-  case COMM_PROTOCOL_CONFIG_MAX_Y_FREQ:
-    machine.config.max_freq[Y_AXIS] = value;
+  case COMM_PROTOCOL_CONFIG_ARC_TOLERANCE:
+    machine.config.arc_tolerance = value;
     break;
-  case COMM_PROTOCOL_CONFIG_MAX_Z_FREQ:
-    machine.config.max_freq[Z_AXIS] = value;
+  case COMM_PROTOCOL_CONFIG_HOME_DIR:
+    machine.config.home_dir = value;
     break;
-  case COMM_PROTOCOL_CONFIG_RAPID_X_D:
-    machine.config.rapid_delta[X_AXIS] = value;
+  case COMM_PROTOCOL_CONFIG_SOFT_LIMITS:
+    machine.config.soft_limits = value & ((1<<AXES_COUNT) - 1);
+    machine.latch_stale = TRUE;
     break;
-  case COMM_PROTOCOL_CONFIG_RAPID_Y_D:
-    machine.config.rapid_delta[Y_AXIS] = value;
+  case COMM_PROTOCOL_CONFIG_SLOW_DEPTH:
+    machine.config.slow_depth = MIN(value, CNC_PIPE_CAPACITY);
     break;
-  case COMM_PROTOCOL_CONFIG_RAPID_Z_D:
-    machine.config.rapid_delta[Z_AXIS] = value;
+  case COMM_PROTOCOL_CONFIG_SLOW_TIME:
+    machine.config.slow_time = value;
     break;
   }
 }
@@ -10,7 +10,13 @@
 
 #include "system.h"
 
+#if defined(CONFIG_CNC_STEP_TIMER)
+#define CNC_TIMER_FREQ        (CNC_STEP_TIMER_FREQ)
+#elif defined(CONFIG_CNC_DMA_WAVE)
+#define CNC_TIMER_FREQ        (CNC_WAVE_FREQ)
+#else
 #define CNC_TIMER_FREQ        (SYS_MAIN_TIMER_FREQ)
+#endif
 
 #define CNC_MAX_STEP_FREQ     (480*CNC_STEPS_PER_MM_X/60)
 #define CNC_STEPS_PER_MM_X    (400)
@@ -18,12 +24,39 @@
 #define CNC_STEPS_PER_MM_Z    (400)
 
 #define CNC_FP_DECIMALS       (14)
-#define CNC_PIPE_CAPACITY     (128)
-#define CNC_RAPID_ACC_DEC     ((1<<CNC_FP_DECIMALS)/2)
+/* Axis timer counter period and step pin high phase */
+#define CNC_TIMER_FULL        ((u32_t)CNC_TIMER_FREQ << CNC_FP_DECIMALS)
+#define CNC_TIMER_HALF        (CNC_TIMER_FULL / 2)
+/* Highest axis frequency not overflowing the axis timer counter */
+#define CNC_STEP_FREQ_LIMIT   ((0xffffffff - CNC_TIMER_FULL) >> CNC_FP_DECIMALS)
+/* Number of queued motions, must be a power of two */
+#ifndef CNC_PIPE_CAPACITY
+#define CNC_PIPE_CAPACITY     (256)
+#endif
+#define CNC_MAX_ACC           (200*CNC_STEPS_PER_MM_X)
+#define CNC_RAPID_ACC         (CNC_MAX_ACC)
+#define CNC_START_FREQ        (60*CNC_STEPS_PER_MM_X/60)
+#define CNC_JERK              (0)
+/* Feed override range in percent */
+#define CNC_FEED_OVERRIDE_MIN (10)
+#define CNC_FEED_OVERRIDE_MAX (200)
+/* Homing seek and locate frequencies, back off and longest seek in steps */
+#define CNC_HOME_SEEK_FREQ    (CNC_MAX_STEP_FREQ/2)
+#define CNC_HOME_LOCATE_FREQ  (CNC_START_FREQ/4)
+#define CNC_HOME_BACKOFF      (2*CNC_STEPS_PER_MM_X)
+#define CNC_HOME_TRAVEL       (300*CNC_STEPS_PER_MM_X)
+/* Backlash take up frequency, steps without ramping */
+#define CNC_BACKLASH_FREQ     (CNC_START_FREQ)
+/* Pipe slowdown, off by default */
+#define CNC_SLOW_DEPTH        (0)
+#define CNC_SLOW_TIME         (20000)
+/* 0.01 mm in 1/1000 steps */
+#define CNC_JUNCTION_DEV      (10*CNC_STEPS_PER_MM_X)
+/* 0.002 mm in 1/1000 steps */
+#define CNC_ARC_TOLERANCE     (2*CNC_STEPS_PER_MM_X)
 
 #define CNC_PROBE_DISABLED    (-1)
 #define CNC_PROBE_NOCONTACT   (0)
-#define CNC_PROBE_SENSE   	   (1)
 #define CNC_PROBE_CONTACT     (2)
 
 #define CNC_STATUS_BIT_CONTROL_ENABLED   (0)
@@ -37,59 +70,286 @@
 #define CNC_STATUS_BIT_PIPE_FULL		      (6)
 #define CNC_STATUS_BIT_LATCH_FULL		    (7)
 
+#define CNC_STATUS_BIT_FEED_HOLD         (16)
+#define CNC_STATUS_BIT_FEED_HELD         (17)
+#define CNC_STATUS_BIT_HOMING            (18)
+#define CNC_STATUS_BIT_HOMED             (19)
+
 #define CNC_ERROR_BIT_EMERGENCY          (0)
 #define CNC_ERROR_BIT_SETTINGS_CORRUPT   (1)
 #define CNC_ERROR_BIT_COMM_LOST          (2)
+#define CNC_ERROR_BIT_HOMING             (3)
+#define CNC_ERROR_BIT_SOFT_LIMIT         (4)
 
 #define CNC_ERR_LATCH_BUSY              (-1)
+#define CNC_ERR_LATCH_ARG               (-2)
+#define CNC_ERR_LATCH_LIMIT             (-3)
+
 
+#ifndef CNC_AXES
+#define CNC_AXES              (3)
+#endif
+#if CNC_AXES < 3 || CNC_AXES > 4
+#error CNC_AXES must be 3 or 4
+#endif
 
 typedef enum {
   X_AXIS = 0,
   Y_AXIS,
   Z_AXIS,
+#if CNC_AXES > 3
+  A_AXIS,
+#endif
   AXES_COUNT
 } CNC_Axis_t;
 
+/* Expands f(axis) for each axis, unrolling per axis code at compile time */
+#if CNC_AXES > 3
+#define CNC_FOR_EACH_AXIS(f)  f(X_AXIS) f(Y_AXIS) f(Z_AXIS) f(A_AXIS)
+#else
+#define CNC_FOR_EACH_AXIS(f)  f(X_AXIS) f(Y_AXIS) f(Z_AXIS)
+#endif
+
 /**
- * Defines an 1D movement in an axis
+ * Defines an 1D movement in an axis, snapshot of running motion registers
  */
 typedef struct CNC_Vector_s {
-	volatile u32_t timer_counter;
-	volatile u32_t step_freq;
-	volatile u32_t step_count;
-  volatile u32_t step_count_half;
-  volatile u32_t step_freq_adj;
-	volatile bool dir;
+	u32_t timer_counter;
+	u32_t step_freq;
+	u32_t step_count;
+  /* Steps rapid axis took accelerating */
+  u32_t ramp_steps;
+  u32_t step_freq_adj;
+  /* Axis speed per path speed for planned motions, see cnc_planner.h */
+  u32_t step_factor;
+  /* Total steps of axis in motion */
+  u32_t step_total;
+  /* Bresenham error term of minor axis in coordinated motion */
+  u32_t bres_err;
+	bool dir;
 } CNC_Vector_t;
 
 /**
- * Defines a 3D movement direction + pause for all axes
+ * Planner data of a queued motion. Speeds are path speeds in steps/s. Entry
+ * and exit speeds are read by the timer when the motion becomes current.
+ */
+typedef struct CNC_Plan_s {
+  /* Path length in steps, zero if motion is not planned */
+  u32_t length;
+  /* Nominal path speed */
+  u32_t nominal;
+  /* Path acceleration in steps/s^2 */
+  u32_t acc;
+  /* Path jerk in steps/s^3, zero for trapezoidal profile */
+  u32_t jerk;
+  /* Lowest path speed, motion can always start or stop at this speed */
+  u32_t floor;
+  /* Highest entry speed allowed by junction to previous motion */
+  u32_t max_entry;
+  /* Planned entry speed */
+  volatile u32_t entry;
+  /* Planned exit speed */
+  volatile u32_t exit;
+  /* Dominant axis */
+  u8_t dom;
+} CNC_Plan_t;
+
+/**
+ * Velocity profile of a planned motion as followed by the timer. Speeds are
+ * path speeds in steps/s << CNC_FP_DECIMALS.
+ */
+typedef struct CNC_Profile_s {
+  /* Entry speed, zero if motion is not planned */
+  u32_t entry;
+  /* Exit speed */
+  u32_t exit;
+  /* Cruise speed */
+  u32_t nominal;
+  /* Start speed from stand still */
+  u32_t floor;
+  /* Speed increment per timer tick */
+  u32_t acc_tick;
+  /* Steps left on dominant axis when deceleration starts */
+  u32_t decel_steps;
+  /* Highest speed of s-curve profile */
+  u32_t peak;
+  /* S-curve table phase increments per timer tick of acceleration and
+     deceleration, zero for trapezoidal profile */
+  u32_t acc_phase_inc;
+  u32_t dec_phase_inc;
+  /* Start speed and table phase of current s-curve transition */
+  u32_t from;
+  u32_t phase;
+  /* Set when s-curve deceleration started */
+  u8_t decel;
+  /* Dominant axis */
+  u8_t dom;
+} CNC_Profile_t;
+
+/**
+ * Defines a movement direction + pause for all axes
  */
 typedef struct CNC_Motion_s {
   u32_t id;
 	CNC_Vector_t vector[AXES_COUNT];
-	volatile u32_t pause;
-	volatile bool rapid;
+	u32_t pause;
+	bool rapid;
+  CNC_Profile_t profile;
 } CNC_Motion_t;
 
+/* Queued motion flags, bits 0..AXES_COUNT-1 are positive axis directions */
+/* Motion reverses an axis having backlash, entered from standstill */
+#define CNC_QUEUED_BACKLASH   (1<<5)
+#define CNC_QUEUED_RAPID      (1<<6)
+#define CNC_QUEUED_PAUSE      (1<<7)
+
+/**
+ * Packed motion as queued in the pipe. The runtime registers of a
+ * CNC_Motion_t are derived from this when the motion becomes current.
+ */
+typedef struct CNC_Queued_s {
+  u32_t id;
+  /* Steps of each axis */
+  u32_t steps[AXES_COUNT];
+  /* Dominant axis frequency in Hz << CNC_FP_DECIMALS, other axes run
+     proportionally. Pause counter for pauses. */
+  u32_t rate;
+  /* Timer ticks motion takes at full feed, see CNC_PLAN_ticks */
+  u32_t ticks;
+  /* CNC_QUEUED_* flags and axis directions */
+  u8_t flags;
+  CNC_Plan_t plan;
+} CNC_Queued_t;
+
 typedef struct CNC_Config_s {
   u32_t max_freq[AXES_COUNT];
-  u32_t rapid_delta[AXES_COUNT];
+  /* Rapid acceleration in steps/s^2, zero for no limit. Rapids ramp
+     from their start frequency up to max_freq and back. */
+  u32_t rapid_acc[AXES_COUNT];
+  /* Acceleration in steps/s^2, zero for no limit */
+  u32_t acc[AXES_COUNT];
+  /* Frequency in Hz an axis can start at or stop from without ramping */
+  u32_t start_freq[AXES_COUNT];
+  /* Jerk in steps/s^3, zero for trapezoidal profiles */
+  u32_t jerk[AXES_COUNT];
+  /* Junction deviation in 1/1000 steps, zero to limit junction speeds by
+     axis start frequencies only */
+  u32_t junction_dev;
+  /* Arc chord error in 1/1000 steps */
+  u32_t arc_tolerance;
+  /* Homing seek and locate frequencies in Hz */
+  u32_t home_seek[AXES_COUNT];
+  u32_t home_locate[AXES_COUNT];
+  /* Homing back off from switch and longest switch seek in steps */
+  u32_t home_backoff[AXES_COUNT];
+  u32_t home_travel[AXES_COUNT];
+  /* Axes having their home switch in positive direction */
+  u32_t home_dir;
+  /* Backlash in steps, taken up at given frequency in Hz before a motion
+     reversing the axis. Take up steps do not change machine position. */
+  u32_t backlash[AXES_COUNT];
+  u32_t backlash_freq[AXES_COUNT];
+  /* Machine envelope in steps of machine position, enforced on axes in
+     soft_limits mask. Kept over CNC_reset. */
+  s32_t soft_min[AXES_COUNT];
+  s32_t soft_max[AXES_COUNT];
+  u32_t soft_limits;
+  /* Planned motions latched while pipe holds fewer than slow_depth motions
+     are slowed to last at least slow_time us scaled by how far pipe is below
+     slow_depth, zero slow_depth disables */
+  u32_t slow_depth;
+  u32_t slow_time;
 } CNC_Config_t;
 
+/**
+ * Pipe statistics, kept from CNC_reset or last read with reset
+ */
+typedef struct CNC_Pipe_stats_s {
+  /* Times pipe ran empty after running motions, counting the end of each
+     motion stream too */
+  u32_t underruns;
+  /* Fewest motions left in pipe when a motion was loaded from it,
+     CNC_PIPE_CAPACITY if none was */
+  u32_t min_depth;
+  /* Motions loaded from pipe */
+  u32_t motions;
+} CNC_Pipe_stats_t;
+
+/* Called from timer on each status register change */
 typedef void (*cnc_sr_callback)(u32_t sr);
 typedef void (*cnc_pipe_callback)(u32_t id);
-typedef void (*cnc_pos_callback)(s32_t x, s32_t y, s32_t z);
-typedef void (*cnc_offs_callback)(s32_t x, s32_t y, s32_t z);
+/* Called with AXES_COUNT positions when position or offset is set */
+typedef void (*cnc_pos_callback)(const s32_t *pos);
+typedef void (*cnc_offs_callback)(const s32_t *pos);
+/* Called from probe interrupt with AXES_COUNT captured positions */
+typedef void (*cnc_probe_callback)(const s32_t *pos);
 
 void CNC_timer();
 
+#ifdef CONFIG_CNC_STEP_TIMER
+/**
+ * Runs the cnc engine for the step timer ticks elapsed since last call.
+ * Returns number of step timer ticks until next call.
+ */
+u32_t CNC_step_timer();
+#endif
+
+#ifdef CONFIG_CNC_DMA_WAVE
+/**
+ * Runs the cnc engine for len ticks, storing the cnc port BSRR word of each
+ * tick in dst instead of writing the port.
+ */
+void CNC_wave_block(u32_t *dst, u32_t len);
+/**
+ * Returns the dma double buffer of 2*CNC_WAVE_BLOCK port words.
+ */
+u32_t *CNC_wave_buffer();
+/**
+ * Refills buffer half 0 or 1 after it has been streamed to port.
+ */
+void CNC_wave_fill(u32_t half);
+#endif
+
+#ifdef CONFIG_CNC_TRACE
+/**
+ * Step trace entry, a cnc port BSRR word and the engine tick it was
+ * written at
+ */
+typedef struct CNC_Trace_s {
+  u32_t tick;
+  u32_t bsrr;
+} CNC_Trace_t;
+
+/**
+ * Reads and removes up to max oldest trace entries into dst. Returns
+ * number of read entries.
+ */
+u32_t CNC_trace_read(CNC_Trace_t *dst, u32_t max);
+/**
+ * Empties trace and restarts engine tick count.
+ */
+u32_t CNC_trace_clear();
+/**
+ * Prints and empties trace.
+ */
+u32_t CNC_trace_dump();
+#endif
+
 void CNC_init(cnc_sr_callback sr_f, cnc_pipe_callback pipe_f,
-    cnc_pos_callback pos_f, cnc_offs_callback offs_f);
+    cnc_pos_callback pos_f, cnc_offs_callback offs_f, cnc_probe_callback probe_f);
 
 u32_t CNC_get_status();
 void CNC_set_status_mask(u32_t mask);
+/**
+ * Called from deferred context with each status register passed to the
+ * status callback, returns nonzero if the change is within report mask.
+ */
+u32_t CNC_status_report(u32_t sr);
+/**
+ * Called from deferred context with each status register passed to the
+ * status callback, updates cnc leds.
+ */
+void CNC_status_leds(u32_t sr);
 u32_t CNC_get_error_mask();
 void CNC_set_error_mask(u32_t mask);
 
@@ -100,32 +360,138 @@ void CNC_get_motion(CNC_Motion_t* pMotion);
 
 void CNC_pipeline_flush();
 void CNC_pipeline_enable(u32_t enable);
+/**
+ * Returns timer ticks left of current motion and all motions in pipe, at
+ * current feed override and as planned so far. Feed hold is not counted,
+ * backlash take up is counted once it runs, arc segments once they are
+ * latched. Kept as motions are latched,
+ * replanned and run, so this does not walk the pipe.
+ */
+u32_t CNC_get_queue_time();
+/**
+ * Reads pipe statistics, restarting them if reset is nonzero.
+ */
+void CNC_get_pipe_stats(CNC_Pipe_stats_t *stats, u32_t reset);
 
 void CNC_set_enabled(u32_t);
 
+/**
+ * Sets feed override in percent of all motions, clamped to
+ * CNC_FEED_OVERRIDE_MIN..CNC_FEED_OVERRIDE_MAX. Axis frequencies ramp to the
+ * new feed within axis accelerations. Returns the override set.
+ */
+u32_t CNC_set_feed_override(u32_t percent);
+u32_t CNC_get_feed_override();
+/**
+ * Feed hold decelerates all axes to a stop within axis accelerations, motion
+ * stays current and is resumed from where it stopped when hold is released.
+ */
+void CNC_feed_hold(u32_t hold);
+
 u32_t CNC_latch_pause(u32_t timeInMs);
+/**
+ * Latches a motion of AXES_COUNT signed steps and step frequencies. A motion
+ * ending outside soft limits is not latched, CNC_ERR_LATCH_LIMIT is returned
+ * and error bit soft limit is set.
+ */
+u32_t CNC_latch(const s32_t *steps, const u32_t *freq, u32_t rapid);
+/**
+ * Latches a motion of x, y and z, other axes stand still.
+ */
 u32_t CNC_latch_xyz(s32_t stepsX, u32_t freqX, s32_t stepsY, u32_t freqY, s32_t stepsZ, u32_t freqZ, u32_t rapid);
+/**
+ * Latches as many of given n motions as fit in the pipe. Each motion is
+ * given by id-less step_count, dir and step_freq of each axis and rapid, or
+ * by pause in milliseconds. Returns number of latched motions, and the id of
+ * first latched motion in pFirstId if any was latched. Stops at first motion
+ * outside soft limits, pFirstId gets CNC_ERR_LATCH_LIMIT if it is the first.
+ */
+u32_t CNC_latch_batch(const CNC_Motion_t *m, u32_t n, u32_t *pFirstId);
+/**
+ * Latches an arc in given CNC_ARC_PLANE_* from current position, with
+ * centre (c0, c1) and end (e0, e1) in steps relative to start, counter
+ * clockwise if ccw, with path speed feed in Hz << CNC_FP_DECIMALS. A full
+ * circle is given by zero end. The arc is fed into the pipe as segments
+ * sharing one id, and latch stays busy until all segments are latched.
+ * Soft limits are checked against the bounding box of the whole arc.
+ */
+u32_t CNC_latch_arc(u32_t plane, s32_t c0, s32_t c1, s32_t e0, s32_t e1, u32_t ccw, u32_t feed);
+/**
+ * Called from deferred context when pipe has drained, latches pending arc
+ * segments.
+ */
+void CNC_pipeline_feed();
+/**
+ * Returns TRUE while an arc has segments left to feed into the pipe, safe
+ * from any context.
+ */
+u32_t CNC_pipeline_feed_pending();
 
+/**
+ * Overwrites current motion with AXES_COUNT signed steps and step
+ * frequencies.
+ */
+void CNC_set_imm(const s32_t *steps, const u32_t *freq);
 void CNC_set_regs_imm(s32_t stepsX, u32_t freqX, s32_t stepsY, u32_t freqY, s32_t stepsZ, u32_t freqZ);
 void CNC_set_x_imm(s32_t stepsX, u32_t freqX);
 void CNC_set_y_imm(s32_t stepsY, u32_t freqY);
 void CNC_set_z_imm(s32_t stepsZ, u32_t freqZ);
 
-void CNC_get_pos(s32_t* px, s32_t* py, s32_t* pz);
-void CNC_set_pos(s32_t x, s32_t y, s32_t z);
-void CNC_get_offs_pos(s32_t* px, s32_t* py, s32_t* pz);
-void CNC_set_offs_pos(s32_t x, s32_t y, s32_t z);
-void CNC_config_pos(s32_t x, s32_t y, s32_t z);
-void CNC_config_offs_pos(s32_t x, s32_t y, s32_t z);
+/* Positions are arrays of AXES_COUNT steps */
+void CNC_get_pos(s32_t *pos);
+/**
+ * Returns consistent snapshot of machine position, without offset.
+ */
+void CNC_get_machine_pos(s32_t *pos);
+void CNC_set_pos(const s32_t *pos);
+void CNC_get_offs_pos(s32_t *pos);
+void CNC_set_offs_pos(const s32_t *pos);
+void CNC_config_pos(const s32_t *pos);
+void CNC_config_offs_pos(const s32_t *pos);
 
-void CNC_set_probe(u32_t enabled, u32_t contactCount, u32_t probeZFreqOnTouch);
+/**
+ * Arms or disarms the probe. An armed probe contact captures the position,
+ * decelerates current motion to a stop within axis accelerations and drops
+ * what is left of it. Motions in pipe are run after the stop.
+ * With CONFIG_CNC_DMA_WAVE the probe cannot be armed, status stays
+ * CNC_PROBE_DISABLED.
+ */
+void CNC_set_probe(u32_t enabled);
 u32_t CNC_get_probe_status();
+/**
+ * Gets position captured at last probe contact, with offset like CNC_get_pos.
+ */
+void CNC_get_probe_pos(s32_t *pos);
+/**
+ * Called from sense pin edge interrupt. Must not preempt nor be preempted by
+ * the cnc engine.
+ */
+void CNC_probe_irq();
+
+/**
+ * Homes given axes mask, z first, then x, y and a. Each axis seeks its
+ * switch, backs off, locates switch slowly again and is zeroed where the
+ * switch closes. Homing starts when current motion ends, motions in pipe
+ * wait meanwhile. Progress and completion are reported by status bits
+ * homing and homed, failure by error bit homing. Returns FALSE if already
+ * homing.
+ */
+u32_t CNC_home(u32_t axes);
+/**
+ * Called from limit switch closing edge interrupt of given axis. Must not
+ * preempt nor be preempted by the cnc engine.
+ */
+void CNC_limit_irq(CNC_Axis_t a);
 
 void CNC_set_error_mask(u32_t error_mask);
 void CNC_enable_error(u32_t error);
 void CNC_disable_error(u32_t error);
 
-void CNC_set_config(CNC_Config_t *config);
+/**
+ * Sets whole configuration, frequencies and depths limited like by
+ * CNC_set_config_specific.
+ */
+void CNC_set_config(const CNC_Config_t *config);
 CNC_Config_t *CNC_get_config();
 void CNC_set_config_specific(u8_t config, u32_t value);
 
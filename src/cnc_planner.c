@@ -0,0 +1,363 @@
+/*
+ * cnc_planner.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: agent
+ */
+
+#include "cnc_planner.h"
+
+#ifdef CONFIG_CNC
+
+/* Cap of path acceleration, also used when no axis has an acceleration limit */
+#define CNC_PLAN_MAX_ACC      (1<<24)
+/* Cosine in CNC_PLAN_FACTOR_Q of the largest direction change of a near
+   straight junction, 10 degrees */
+#define CNC_PLAN_STRAIGHT_COS (64540)
+
+const u16_t CNC_PLAN_scurve[CNC_PLAN_SCURVE_SEGS + 1] = {
+  0, 94, 368, 810, 1408, 2150, 3024, 4018,
+  5120, 6318, 7600, 8954, 10368, 11830, 13328, 14850,
+  16384, 17918, 19440, 20938, 22400, 23814, 25168, 26450,
+  27648, 28750, 29744, 30618, 31360, 31958, 32400, 32674,
+  32768
+};
+
+u32_t CNC_PLAN_sqrt(u64_t x) {
+  u64_t res = 0;
+  u64_t bit = (u64_t)1 << 62;
+  while (bit > x) {
+    bit >>= 2;
+  }
+  while (bit != 0) {
+    if (x >= res + bit) {
+      x -= res + bit;
+      res = (res >> 1) + bit;
+    } else {
+      res >>= 1;
+    }
+    bit >>= 2;
+  }
+  return (u32_t)res;
+}
+
+u8_t CNC_PLAN_dominant(const CNC_Queued_t *q) {
+  u8_t dom = 0;
+  int a;
+  for (a = 1; a < AXES_COUNT; a++) {
+    if (q->steps[a] > q->steps[dom]) {
+      dom = a;
+    }
+  }
+  return dom;
+}
+
+void CNC_PLAN_motion(CNC_Queued_t *q, const CNC_Config_t *cfg) {
+  CNC_Plan_t *plan = &q->plan;
+  u64_t len2 = 0;
+  int a;
+
+  memset(plan, 0, sizeof(CNC_Plan_t));
+  plan->dom = CNC_PLAN_dominant(q);
+  if (q->flags & (CNC_QUEUED_RAPID | CNC_QUEUED_PAUSE)) {
+    return;
+  }
+
+  u32_t dom_steps = q->steps[plan->dom];
+  if (dom_steps == 0) {
+    return;
+  }
+  for (a = 0; a < AXES_COUNT; a++) {
+    len2 += (u64_t)q->steps[a] * q->steps[a];
+  }
+
+  u32_t len = CNC_PLAN_sqrt(len2);
+  // path speed requested by host, derived from dominant axis frequency
+  u64_t host_nominal = ((u64_t)q->rate * len) / dom_steps;
+  if (host_nominal == 0) {
+    return;
+  }
+  u32_t nominal = (u32_t)(host_nominal >> CNC_FP_DECIMALS);
+  u32_t acc = CNC_PLAN_MAX_ACC;
+  u64_t jerk = 0xffffffff;
+  u32_t floor = 0xffffffff;
+
+  for (a = 0; a < AXES_COUNT; a++) {
+    u32_t s = q->steps[a];
+    if (s == 0) {
+      continue;
+    }
+    // axis limits scaled to path
+    nominal = MIN(nominal, (u32_t)(((u64_t)cfg->max_freq[a] * len) / s));
+    if (cfg->acc[a] > 0) {
+      acc = MIN(acc, (u32_t)(((u64_t)cfg->acc[a] * len) / s));
+    }
+    if (cfg->jerk[a] > 0) {
+      jerk = MIN(jerk, ((u64_t)cfg->jerk[a] * len) / s);
+    }
+    floor = MIN(floor, (u32_t)(((u64_t)cfg->start_freq[a] * len) / s));
+  }
+
+  plan->length = len;
+  plan->nominal = MAX(1, nominal);
+  plan->jerk = 0;
+  for (a = 0; a < AXES_COUNT; a++) {
+    if (q->steps[a] > 0 && cfg->jerk[a] > 0) {
+      // s-curve peaks at 1.5 times mean acceleration, plan with mean
+      plan->jerk = MAX(1, (u32_t)jerk);
+      acc = acc * 2 / 3;
+      break;
+    }
+  }
+  plan->acc = MAX(1, acc);
+  plan->floor = MAX(1, MIN(floor, plan->nominal));
+  plan->max_entry = plan->floor;
+  plan->entry = plan->floor;
+  plan->exit = plan->floor;
+}
+
+u32_t CNC_PLAN_factor(const CNC_Queued_t *q, int a) {
+  if (q->plan.length == 0) {
+    return 0;
+  }
+  return (u32_t)(((u64_t)q->steps[a] << CNC_PLAN_FACTOR_Q) / q->plan.length);
+}
+
+// Junction speed where centripetal acceleration of a circle touching both
+// motions, deviating junction_dev from the corner, equals path acceleration.
+// cos_q is the cosine of the direction change in CNC_PLAN_FACTOR_Q.
+static u32_t junction_deviation(s32_t cos_q, u32_t acc, u32_t dev) {
+  const u32_t one = 1 << CNC_PLAN_FACTOR_Q;
+  // sin of half the angle between the motions, 1 when collinear
+  u32_t sin2 = (u32_t)MAX(0, MIN((s32_t)one, (s32_t)(one + cos_q) / 2));
+  u32_t sin = CNC_PLAN_sqrt((u64_t)sin2 << CNC_PLAN_FACTOR_Q);
+  if (sin >= one) {
+    return 0xffffffff;
+  }
+  return CNC_PLAN_sqrt(((u64_t)acc * dev * sin) / ((u64_t)(one - sin) * 1000));
+}
+
+u32_t CNC_PLAN_junction(const CNC_Queued_t *prev, const CNC_Queued_t *next, const CNC_Config_t *cfg) {
+  if (prev->plan.length == 0 || next->plan.length == 0) {
+    return next->plan.floor;
+  }
+  u32_t v = MIN(prev->plan.nominal, next->plan.nominal);
+  u32_t v_jump = v;
+  s32_t cos_q = 0;
+  int a;
+  for (a = 0; a < AXES_COUNT; a++) {
+    // signed axis speed factors before and after junction
+    s32_t fp = (prev->flags & (1<<a)) ?
+        (s32_t)CNC_PLAN_factor(prev, a) : -(s32_t)CNC_PLAN_factor(prev, a);
+    s32_t fn = (next->flags & (1<<a)) ?
+        (s32_t)CNC_PLAN_factor(next, a) : -(s32_t)CNC_PLAN_factor(next, a);
+    u32_t d = ABS(fp - fn);
+    if (d > 0) {
+      // axis speed jump at junction must not exceed the axis start frequency
+      u32_t lim = (u32_t)(((u64_t)cfg->start_freq[a] << CNC_PLAN_FACTOR_Q) / d);
+      v_jump = MIN(v_jump, lim);
+    }
+    cos_q += (s32_t)(((s64_t)fp * fn) >> CNC_PLAN_FACTOR_Q);
+  }
+  if (cfg->junction_dev > 0) {
+    // deviation caps corners, near straight joins of linearized curves
+    // may still flow through as fast as axis speed jumps allow
+    u32_t v_dev = junction_deviation(cos_q,
+        MIN(prev->plan.acc, next->plan.acc), cfg->junction_dev);
+    if (cos_q >= CNC_PLAN_STRAIGHT_COS) {
+      v_dev = MAX(v_dev, v_jump);
+    }
+    v = MIN(v, v_dev);
+  } else {
+    v = v_jump;
+  }
+  return MAX(v, MIN(prev->plan.floor, next->plan.floor));
+}
+
+// timer ticks of an s-curve transition changing speed by dv, limited by
+// peak acceleration and by jerk
+static u32_t scurve_ticks(u32_t dv, const CNC_Plan_t *plan) {
+  if (dv == 0) {
+    return 0;
+  }
+  // plan acceleration is the mean, peak is 1.5 times that
+  u64_t t_acc = ((u64_t)dv * CNC_TIMER_FREQ) / plan->acc;
+  // constant jerk 6*dv/t^2 in the middle of the transition
+  u64_t t_jerk = CNC_PLAN_sqrt(((u64_t)6 * dv * CNC_TIMER_FREQ * CNC_TIMER_FREQ) / plan->jerk);
+  return (u32_t)MAX(t_acc, t_jerk);
+}
+
+// s-curve table phase increment per timer tick for a transition of given
+// ticks, rounded up so transition never takes longer than planned
+static u32_t scurve_phase_inc(u32_t ticks) {
+  if (ticks == 0) {
+    return CNC_PLAN_PHASE_END;
+  }
+  return (CNC_PLAN_PHASE_END + ticks - 1) / ticks;
+}
+
+// timer ticks of a speed transition from v0 to v1 and its distance in steps
+static u32_t transition_ticks(const CNC_Plan_t *plan, u32_t v0, u32_t v1, u64_t *len) {
+  u32_t dv = v1 > v0 ? v1 - v0 : v0 - v1;
+  u32_t ticks = plan->jerk ? scurve_ticks(dv, plan) :
+      (u32_t)(((u64_t)dv * CNC_TIMER_FREQ) / plan->acc);
+  // mean speed is halfway for both ramps and symmetric s-curves
+  *len = ((u64_t)(v0 + v1) * ticks) / (2 * CNC_TIMER_FREQ);
+  return ticks;
+}
+
+u32_t CNC_PLAN_reach(const CNC_Plan_t *plan, u32_t v, u32_t len) {
+  u32_t reach = CNC_PLAN_sqrt((u64_t)v * v + 2 * (u64_t)plan->acc * len);
+  u64_t d;
+  if (plan->jerk == 0) {
+    return reach;
+  }
+  transition_ticks(plan, v, reach, &d);
+  if (d <= len) {
+    // acceleration limited, jerk lets the s-curve keep mean acceleration
+    return reach;
+  }
+  // jerk limited, small speed changes take longer than at mean
+  // acceleration. Find highest speed whose transition fits, distance grows
+  // with speed change.
+  u32_t lo = v, hi = reach - 1;
+  while (lo < hi) {
+    u32_t mid = lo + (hi - lo + 1) / 2;
+    transition_ticks(plan, v, mid, &d);
+    if (d <= len) {
+      lo = mid;
+    } else {
+      hi = mid - 1;
+    }
+  }
+  return lo;
+}
+
+// highest speed of a profile from entry to exit speed, and distance the
+// profile decelerates over
+static u32_t profile_peak(const CNC_Plan_t *plan, u32_t entry, u32_t exit, u64_t *decel_len) {
+  u64_t n2 = (u64_t)plan->nominal * plan->nominal;
+  u64_t e2 = (u64_t)entry * entry;
+  u64_t x2 = (u64_t)exit * exit;
+  u64_t acc2 = 2 * (u64_t)plan->acc;
+  u64_t accel_len = (n2 - e2) / acc2;
+  u32_t peak = plan->nominal;
+  *decel_len = (n2 - x2) / acc2;
+
+  if (accel_len + *decel_len > plan->length) {
+    // nominal speed not reachable, acceleration meets deceleration
+    s64_t meet = ((s64_t)(acc2 * plan->length) + (s64_t)x2 - (s64_t)e2) / (s64_t)(2 * acc2);
+    if (meet < 0) {
+      meet = 0;
+    } else if (meet > plan->length) {
+      meet = plan->length;
+    }
+    *decel_len = plan->length - meet;
+    peak = MIN(plan->nominal,
+        CNC_PLAN_sqrt((u64_t)entry * entry + acc2 * (u64_t)meet));
+  }
+  if (plan->jerk) {
+    // s-curve transitions take at least as long as trapezoid ramps, find
+    // highest peak both transitions fit under, distance grows with peak
+    u32_t lo = MAX(entry, exit), hi = MAX(peak, lo);
+    u64_t a, d;
+    transition_ticks(plan, entry, hi, &a);
+    transition_ticks(plan, hi, exit, &d);
+    if (a + d > plan->length) {
+      while (lo < hi) {
+        u32_t mid = lo + (hi - lo + 1) / 2;
+        transition_ticks(plan, entry, mid, &a);
+        transition_ticks(plan, mid, exit, &d);
+        if (a + d <= plan->length) {
+          lo = mid;
+        } else {
+          hi = mid - 1;
+        }
+      }
+    }
+    peak = hi;
+    transition_ticks(plan, peak, exit, decel_len);
+  }
+  return peak;
+}
+
+void CNC_PLAN_profile(CNC_Profile_t *p, const CNC_Queued_t *q, u32_t entry, u32_t exit) {
+  const CNC_Plan_t *plan = &q->plan;
+  u64_t decel_len;
+  u32_t peak = profile_peak(plan, entry, exit, &decel_len);
+
+  p->decel = FALSE;
+  p->phase = 0;
+  p->from = entry << CNC_FP_DECIMALS;
+  if (plan->jerk) {
+    p->acc_phase_inc = scurve_phase_inc(scurve_ticks(peak - entry, plan));
+    p->dec_phase_inc = scurve_phase_inc(scurve_ticks(peak - exit, plan));
+    // speeds the passes left out of reach may not fit, then deceleration
+    // starts at once and ends above exit speed
+    decel_len = MIN(plan->length, decel_len);
+  } else {
+    p->acc_phase_inc = 0;
+    p->dec_phase_inc = 0;
+  }
+  p->peak = peak << CNC_FP_DECIMALS;
+
+  p->entry = entry << CNC_FP_DECIMALS;
+  p->exit = exit << CNC_FP_DECIMALS;
+  p->nominal = plan->nominal << CNC_FP_DECIMALS;
+  p->floor = plan->floor << CNC_FP_DECIMALS;
+  p->acc_tick = MAX(1, (u32_t)(((u64_t)plan->acc << CNC_FP_DECIMALS) / CNC_TIMER_FREQ));
+  p->decel_steps = (u32_t)((decel_len * q->steps[plan->dom]) / plan->length);
+  p->dom = plan->dom;
+}
+
+// timer ticks of a rapid axis ramping up from start frequency f0 to max
+// frequency and back over n steps
+static u32_t rapid_ticks(u32_t n, u32_t f0, u32_t fmax, u32_t acc) {
+  if (acc == 0 || f0 >= fmax) {
+    return (u32_t)(((u64_t)n * CNC_TIMER_FREQ) / fmax);
+  }
+  u64_t ramp_len = ((u64_t)fmax * fmax - (u64_t)f0 * f0) / (2 * (u64_t)acc);
+  if (2 * ramp_len >= n) {
+    // turns back halfway before reaching max frequency
+    u32_t peak = CNC_PLAN_sqrt((u64_t)f0 * f0 + (u64_t)acc * n);
+    return (u32_t)((2 * (u64_t)(peak - f0) * CNC_TIMER_FREQ) / acc);
+  }
+  return (u32_t)((2 * (u64_t)(fmax - f0) * CNC_TIMER_FREQ) / acc +
+      ((n - 2 * ramp_len) * CNC_TIMER_FREQ) / fmax);
+}
+
+u32_t CNC_PLAN_ticks(const CNC_Queued_t *q, const CNC_Config_t *cfg) {
+  const CNC_Plan_t *plan = &q->plan;
+  u32_t dom_steps = q->steps[plan->dom];
+  if (q->flags & CNC_QUEUED_PAUSE) {
+    // pause counts down each millisecond and a tick
+    return q->rate == 0 ? 0 : (q->rate - 1) * (CNC_TIMER_FREQ/1000 + 1);
+  }
+  if (q->flags & CNC_QUEUED_RAPID) {
+    // axes ramp on their own, slowest axis ends motion
+    u32_t ticks = 0;
+    int a;
+    for (a = 0; a < AXES_COUNT; a++) {
+      u32_t fmax = MAX(1, cfg->max_freq[a]);
+      if (q->steps[a] == 0) {
+        continue;
+      }
+      u32_t f0 = (u32_t)(((u64_t)q->rate * q->steps[a] / dom_steps) >> CNC_FP_DECIMALS);
+      ticks = MAX(ticks, rapid_ticks(q->steps[a], MIN(f0, fmax), fmax, cfg->rapid_acc[a]));
+    }
+    return ticks;
+  }
+  if (plan->length == 0) {
+    return 0;
+  }
+  u64_t accel_len, decel_len;
+  u32_t peak = profile_peak(plan, plan->entry, plan->exit, &decel_len);
+  u32_t ticks = transition_ticks(plan, plan->entry, peak, &accel_len);
+  ticks += transition_ticks(plan, peak, plan->exit, &decel_len);
+  if (accel_len + decel_len < plan->length) {
+    ticks += (u32_t)(((plan->length - accel_len - decel_len) * CNC_TIMER_FREQ) / peak);
+  }
+  return ticks;
+}
+
+#endif // CONFIG_CNC
@@ -0,0 +1,94 @@
+/*
+ * cnc_planner.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: agent
+ */
+
+#ifndef CNC_PLANNER_H_
+#define CNC_PLANNER_H_
+
+#include "cnc_control.h"
+
+/**
+ * Motion planner math. All planner speeds are path speeds in steps/s, where
+ * the path length of a motion is the euclidean length of its step vector.
+ * Planner functions are pure and do not touch any hardware nor machine state.
+ */
+
+/* Q format of axis speed factors, axis speed = (path speed * factor) >> CNC_PLAN_FACTOR_Q */
+#define CNC_PLAN_FACTOR_Q     (16)
+
+/* Number of segments of s-curve velocity table */
+#define CNC_PLAN_SCURVE_SEGS  (32)
+/* Q format of s-curve velocity table */
+#define CNC_PLAN_SCURVE_Q     (15)
+/* Q format of s-curve table phase, segment index in integer part. Keeps
+   phase increment times timer ticks per engine run within 32 bits. */
+#define CNC_PLAN_PHASE_Q      (18)
+#define CNC_PLAN_PHASE_END    ((u32_t)CNC_PLAN_SCURVE_SEGS << CNC_PLAN_PHASE_Q)
+
+/**
+ * S-curve velocity table, fraction of speed change made at each segment
+ * boundary of a transition, 3u^2 - 2u^3. Acceleration is zero at both ends
+ * and peaks at 1.5 times mean acceleration in the middle.
+ */
+extern const u16_t CNC_PLAN_scurve[CNC_PLAN_SCURVE_SEGS + 1];
+
+/**
+ * Returns the integer square root of x.
+ */
+u32_t CNC_PLAN_sqrt(u64_t x);
+
+/**
+ * Returns the axis with most steps of a queued motion.
+ */
+u8_t CNC_PLAN_dominant(const CNC_Queued_t *q);
+
+/**
+ * Calculates the motion geometry and limits of a queued motion; dominant
+ * axis, path length, nominal speed, acceleration, jerk and floor speed. If
+ * any axis has a jerk limit the motion gets an s-curve profile, planned with
+ * its mean acceleration. Motions
+ * that cannot be planned (rapids, pauses and empty motions) are marked
+ * unplanned.
+ */
+void CNC_PLAN_motion(CNC_Queued_t *q, const CNC_Config_t *cfg);
+
+/**
+ * Returns the speed factor of given axis of a planned motion, zero if the
+ * motion is not planned.
+ */
+u32_t CNC_PLAN_factor(const CNC_Queued_t *q, int a);
+
+/**
+ * Returns the maximum junction speed between planned motion prev and
+ * planned motion next, in path speed of next. The speed keeps each axis
+ * speed jump within its start frequency, or with a junction deviation is
+ * what the deviation allows for the direction change. Near straight joins
+ * get at least the axis speed jump limit then.
+ */
+u32_t CNC_PLAN_junction(const CNC_Queued_t *prev, const CNC_Queued_t *next, const CNC_Config_t *cfg);
+
+/**
+ * Returns the highest speed reachable after changing from speed v over given
+ * distance with acceleration and jerk of planned motion. Without jerk this
+ * is sqrt(v^2 + 2*acc*len), with jerk the s-curve transition must fit in
+ * the distance too.
+ */
+u32_t CNC_PLAN_reach(const CNC_Plan_t *plan, u32_t v, u32_t len);
+
+/**
+ * Calculates the trapezoidal or s-curve profile of a planned motion running
+ * from entry speed to exit speed.
+ */
+void CNC_PLAN_profile(CNC_Profile_t *p, const CNC_Queued_t *q, u32_t entry, u32_t exit);
+
+/**
+ * Returns timer ticks a queued motion takes at full feed, planned motions
+ * running from their planned entry speed to their planned exit speed.
+ * Backlash take up is not included.
+ */
+u32_t CNC_PLAN_ticks(const CNC_Queued_t *q, const CNC_Config_t *cfg);
+
+#endif /* CNC_PLANNER_H_ */
@@ -17,24 +17,58 @@
 #include "comm.h"
 #include "nvstorage.h"
 #include "comm_proto_file.h"
+#include "timer.h"
 
 
 #ifdef CONFIG_CNC
 
 #define COMM_CNC_MAX_STORED_LATCH_IDS 4
+// number of arguments per motion in latch xyz and batch latch, steps and
+// frequency of each axis and rapid
+#define COMM_CNC_MOTION_ARGS          (2*AXES_COUNT + 1)
+// motions converted at a time in a batch latch
+#define COMM_CNC_BATCH_CHUNK          8
+// length of ring of ids of motions leaving the pipe, must be a power of two
+#define COMM_CNC_ID_RING_LEN          32
+// default and max delay of id events in ms
+#define COMM_CNC_ID_TIMER_DEFAULT     10
+#define COMM_CNC_ID_TIMER_MAX         1000
 
 static struct {
   u16_t seqno[COMM_CNC_MAX_STORED_LATCH_IDS];
   u32_t latch_id[COMM_CNC_MAX_STORED_LATCH_IDS];
+  u32_t count[COMM_CNC_MAX_STORED_LATCH_IDS];
   u8_t ix;
 } stored_latch_ids;
 
+static CNC_Motion_t batch_motions[COMM_CNC_BATCH_CHUNK];
+
+// Ids of motions leaving the pipe, written by the cnc timer irq and read by
+// the id timer task only. Indices run freely and wrap on the ring length.
+// When full, the irq keeps the newest id in lost_id and counts it in lost.
+static struct {
+  u32_t id[COMM_CNC_ID_RING_LEN];
+  volatile u32_t wix;
+  volatile u32_t rix;
+  volatile u32_t lost;
+  volatile u32_t lost_id;
+} id_ring;
+// lost count already reported by id timer task
+static u32_t id_ring_lost_seen;
+// Set by cnc timer irq when a pipe feed task is queued, cleared by the task
+static volatile u32_t feed_pending;
+
 static task *task_sr;
 static task *task_pos;
 static task_timer task_sr_timer;
 static task_timer task_pos_timer;
+static task *task_id;
+static task_timer task_id_timer;
+static task *task_persist;
+static task_timer task_persist_timer;
 static u32_t sr_timer_recurrence = 1000;
 static u32_t pos_timer_recurrence = 1000;
+static u32_t id_timer_recurrence = COMM_CNC_ID_TIMER_DEFAULT;
 static comm_sys_cb event_cb;
 
 #define itomem(i, b) \
@@ -48,7 +82,15 @@ static comm_sys_cb event_cb;
     (((b)[2] << 16) & 0x00ff0000) | \
     (((b)[3] << 24) & 0xff000000)
 
-static s32_t comm_cnc_handle_already_received_latch_cmd(u16_t seqno);
+static s32_t comm_cnc_handle_already_received_latch_cmd(u16_t seqno, bool batch);
+static void comm_cnc_store_latch_id(u16_t seqno, u32_t id, u32_t count);
+static u32_t comm_cnc_latch_batch(u8_t *data, u32_t n, u32_t *first_id);
+static u8_t *comm_cnc_mem_to_axes(u8_t *data, s32_t *steps, u32_t *freq);
+static void comm_cnc_pos_to_mem(const s32_t *pos, u8_t *buf);
+
+static u32_t comm_cnc_get_axes() {
+  return AXES_COUNT;
+}
 
 static void comm_cnc_event_cb(enum comm_sys_cb_event event) {
   if (event == DISCONNECTED) {
@@ -111,6 +153,28 @@ u32_t COMM_CNC_get_pos_timer_recurrence() {
   return pos_timer_recurrence;
 }
 
+void COMM_CNC_set_id_timer_recurrence(u32_t delta) {
+  if (delta > 0 && delta <= COMM_CNC_ID_TIMER_MAX) {
+    id_timer_recurrence = delta;
+  } else {
+    id_timer_recurrence = COMM_CNC_ID_TIMER_DEFAULT;
+  }
+}
+
+void COMM_CNC_apply_id_timer_recurrence() {
+  TASK_set_timer_recurrence(&task_id_timer, COMM_CNC_get_id_timer_recurrence());
+  CONFIG_store();
+}
+
+static void comm_cnc_set_and_apply_id_timer_recurrence(u32_t delta) {
+  COMM_CNC_set_id_timer_recurrence(delta);
+  COMM_CNC_apply_id_timer_recurrence();
+}
+
+u32_t COMM_CNC_get_id_timer_recurrence() {
+  return id_timer_recurrence;
+}
+
 u32_t COMM_CNC_get_version() {
   return COMM_CNC_VERSION;
 }
@@ -127,6 +191,9 @@ s32_t COMM_CNC_on_pkt(u16_t seq, u8_t *data, u16_t len, bool already_received) {
   case COMM_PROTOCOL_INFO:
     f = COMM_CNC_get_version;
     break;
+  case COMM_PROTOCOL_GET_AXES:
+    f = comm_cnc_get_axes;
+    break;
   case COMM_PROTOCOL_CNC_ENABLE:
     if (argc == 1) {
       f = CNC_set_enabled;
@@ -169,6 +236,48 @@ s32_t COMM_CNC_on_pkt(u16_t seq, u8_t *data, u16_t len, bool already_received) {
       DBG(D_APP, D_WARN, "COMM_CNC: bad argc on CNC_set_latch_id, %i\n", argc);
     }
     break;
+  case COMM_PROTOCOL_FEED_OVERRIDE:
+    if (argc == 1) {
+      f = CNC_set_feed_override;
+    } else {
+      DBG(D_APP, D_WARN, "COMM_CNC: bad argc on CNC_set_feed_override, %i\n", argc);
+    }
+    break;
+  case COMM_PROTOCOL_FEED_HOLD:
+    if (argc == 1) {
+      f = CNC_feed_hold;
+    } else {
+      DBG(D_APP, D_WARN, "COMM_CNC: bad argc on CNC_feed_hold, %i\n", argc);
+    }
+    break;
+  case COMM_PROTOCOL_SET_PROBE:
+    if (argc == 1) {
+      f = CNC_set_probe;
+    } else {
+      DBG(D_APP, D_WARN, "COMM_CNC: bad argc on CNC_set_probe, %i\n", argc);
+    }
+    break;
+  case COMM_PROTOCOL_GET_PROBE_STATUS:
+    if (argc == 0) {
+      f = CNC_get_probe_status;
+    } else {
+      DBG(D_APP, D_WARN, "COMM_CNC: bad argc on CNC_get_probe_status, %i\n", argc);
+    }
+    break;
+  case COMM_PROTOCOL_HOME:
+    if (argc == 1) {
+      f = CNC_home;
+    } else {
+      DBG(D_APP, D_WARN, "COMM_CNC: bad argc on CNC_home, %i\n", argc);
+    }
+    break;
+  case COMM_PROTOCOL_GET_QUEUE_TIME:
+    if (argc == 0) {
+      f = CNC_get_queue_time;
+    } else {
+      DBG(D_APP, D_WARN, "COMM_CNC: bad argc on CNC_get_queue_time, %i\n", argc);
+    }
+    break;
   case COMM_PROTOCOL_PIPE_ENABLE:
     if (argc == 1) {
       f = CNC_pipeline_enable;
@@ -183,22 +292,10 @@ s32_t COMM_CNC_on_pkt(u16_t seq, u8_t *data, u16_t len, bool already_received) {
       DBG(D_APP, D_WARN, "COMM_CNC: bad argc on CNC_pipeline_flush, %i\n", argc);
     }
     break;
-  case COMM_PROTOCOL_LATCH_XYZ:
-    if (argc == 7) {
-      if (already_received) {
-        return comm_cnc_handle_already_received_latch_cmd(seq);
-      } else {
-        latch_cmd = TRUE;
-        f = CNC_latch_xyz;
-      }
-    } else {
-      DBG(D_APP, D_WARN, "COMM_CNC: bad argc on CNC_latch_xyz, %i\n", argc);
-    }
-    break;
   case COMM_PROTOCOL_LATCH_PAUSE:
     if (argc == 1) {
       if (already_received) {
-        return comm_cnc_handle_already_received_latch_cmd(seq);
+        return comm_cnc_handle_already_received_latch_cmd(seq, FALSE);
       } else {
         latch_cmd = TRUE;
         f = CNC_latch_pause;
@@ -207,25 +304,16 @@ s32_t COMM_CNC_on_pkt(u16_t seq, u8_t *data, u16_t len, bool already_received) {
       DBG(D_APP, D_WARN, "COMM_CNC: bad argc on CNC_latch_pause, %i\n", argc);
     }
     break;
-  case COMM_PROTOCOL_SET_POS:
-    if (argc == 3) {
-      f = CNC_set_pos;
-    } else {
-      DBG(D_APP, D_WARN, "COMM_CNC: bad argc on CNC_set_pos, %i\n", argc);
-    }
-    break;
-  case COMM_PROTOCOL_SET_OFFS_POS:
-    if (argc == 3) {
-      f = CNC_set_offs_pos;
-    } else {
-      DBG(D_APP, D_WARN, "COMM_CNC: bad argc on CNC_set_offs_pos, %i\n", argc);
-    }
-    break;
-  case COMM_PROTOCOL_SET_IMM_XYZ:
-    if (argc == 6) {
-      f = CNC_set_regs_imm;
+  case COMM_PROTOCOL_LATCH_ARC:
+    if (argc == 7) {
+      if (already_received) {
+        return comm_cnc_handle_already_received_latch_cmd(seq, FALSE);
+      } else {
+        latch_cmd = TRUE;
+        f = CNC_latch_arc;
+      }
     } else {
-      DBG(D_APP, D_WARN, "COMM_CNC: bad argc on CNC_set_regs_imm, %i\n", argc);
+      DBG(D_APP, D_WARN, "COMM_CNC: bad argc on CNC_latch_arc, %i\n", argc);
     }
     break;
   case COMM_PROTOCOL_SR_TIMER_DELTA:
@@ -242,6 +330,13 @@ s32_t COMM_CNC_on_pkt(u16_t seq, u8_t *data, u16_t len, bool already_received) {
       DBG(D_APP, D_WARN, "COMM_CNC: bad argc on COMM_CNC_set_and_apply_pos_timer_recurrence, %i\n", argc);
     }
     break;
+  case COMM_PROTOCOL_ID_TIMER_DELTA:
+    if (argc == 1) {
+      f = comm_cnc_set_and_apply_id_timer_recurrence;
+    } else {
+      DBG(D_APP, D_WARN, "COMM_CNC: bad argc on COMM_CNC_set_and_apply_id_timer_recurrence, %i\n", argc);
+    }
+    break;
   case COMM_PROTOCOL_RESET:
     if (argc == 0) {
       f = CNC_reset;
@@ -272,63 +367,178 @@ s32_t COMM_CNC_on_pkt(u16_t seq, u8_t *data, u16_t len, bool already_received) {
     itomem((u32_t)fres, buf);
     if (latch_cmd && (u32_t)fres != CNC_ERR_LATCH_BUSY) {
       // store latch_id for this latch command if we get a resend
-      stored_latch_ids.seqno[stored_latch_ids.ix] = seq;
-      stored_latch_ids.latch_id[stored_latch_ids.ix] = (u32_t)fres;
-      if (stored_latch_ids.ix >= COMM_CNC_MAX_STORED_LATCH_IDS - 1) {
-        stored_latch_ids.ix = 0;
-      } else {
-        stored_latch_ids.ix++;
-      }
+      comm_cnc_store_latch_id(seq, (u32_t)fres, 1);
     }
     res = COMM_reply(buf, sizeof(buf));
   } else {
     switch (cmd) {
-    case COMM_PROTOCOL_GET_POS:
+    case COMM_PROTOCOL_LATCH_XYZ:
     {
-      if (argc == 0) {
+      if (argc == COMM_CNC_MOTION_ARGS) {
+        if (already_received) {
+          return comm_cnc_handle_already_received_latch_cmd(seq, FALSE);
+        }
         LED_blink_single(LED_CNC_COMM_BIT, 2,1,2);
-        s32_t px;
-        s32_t py;
-        s32_t pz;
-        CNC_get_pos(&px, &py, &pz);
-        u8_t buf[sizeof(s32_t)*3];
-        itomem(px, &buf[0]);
-        itomem(py, &buf[4]);
-        itomem(pz, &buf[8]);
+        s32_t steps[AXES_COUNT];
+        u32_t freq[AXES_COUNT];
+        data = comm_cnc_mem_to_axes(data, steps, freq);
+        u32_t id = CNC_latch(steps, freq, memtoi(data));
+        if (id != CNC_ERR_LATCH_BUSY) {
+          // store latch_id for this latch command if we get a resend
+          comm_cnc_store_latch_id(seq, id, 1);
+        }
+        u8_t buf[sizeof(u32_t)];
+        itomem(id, buf);
         res = COMM_reply(buf, sizeof(buf));
       } else {
-        DBG(D_APP, D_WARN, "COMM_CNC: bad argc on CNC_get_pos, %i\n", argc);
+        DBG(D_APP, D_WARN, "COMM_CNC: bad argc on CNC_latch, %i\n", argc);
       }
       break;
     }
+    case COMM_PROTOCOL_SET_IMM_XYZ:
+    {
+      if (argc == 2*AXES_COUNT) {
+        LED_blink_single(LED_CNC_COMM_BIT, 2,1,2);
+        s32_t steps[AXES_COUNT];
+        u32_t freq[AXES_COUNT];
+        comm_cnc_mem_to_axes(data, steps, freq);
+        CNC_set_imm(steps, freq);
+        u8_t buf[sizeof(u32_t)];
+        itomem((u32_t)0, buf);
+        res = COMM_reply(buf, sizeof(buf));
+      } else {
+        DBG(D_APP, D_WARN, "COMM_CNC: bad argc on CNC_set_imm, %i\n", argc);
+      }
+      break;
+    }
+    case COMM_PROTOCOL_SET_POS:
+    case COMM_PROTOCOL_SET_OFFS_POS:
+    {
+      if (argc == AXES_COUNT) {
+        LED_blink_single(LED_CNC_COMM_BIT, 2,1,2);
+        s32_t pos[AXES_COUNT];
+        int a;
+        for (a = 0; a < AXES_COUNT; a++) {
+          pos[a] = memtoi(&data[a*4]);
+        }
+        if (cmd == COMM_PROTOCOL_SET_POS) {
+          CNC_set_pos(pos);
+        } else {
+          CNC_set_offs_pos(pos);
+        }
+        u8_t buf[sizeof(u32_t)];
+        itomem((u32_t)0, buf);
+        res = COMM_reply(buf, sizeof(buf));
+      } else {
+        DBG(D_APP, D_WARN, "COMM_CNC: bad argc on set pos, %i\n", argc);
+      }
+      break;
+    }
+    case COMM_PROTOCOL_GET_POS:
     case COMM_PROTOCOL_GET_OFFS_POS:
     {
       if (argc == 0) {
         LED_blink_single(LED_CNC_COMM_BIT, 2,1,2);
-        s32_t px;
-        s32_t py;
-        s32_t pz;
-        CNC_get_offs_pos(&px, &py, &pz);
-        u8_t buf[sizeof(s32_t)*3];
-        itomem(px, &buf[0]);
-        itomem(py, &buf[4]);
-        itomem(pz, &buf[8]);
+        s32_t pos[AXES_COUNT];
+        if (cmd == COMM_PROTOCOL_GET_POS) {
+          CNC_get_pos(pos);
+        } else {
+          CNC_get_offs_pos(pos);
+        }
+        u8_t buf[sizeof(s32_t)*AXES_COUNT];
+        comm_cnc_pos_to_mem(pos, buf);
+        res = COMM_reply(buf, sizeof(buf));
+      } else {
+        DBG(D_APP, D_WARN, "COMM_CNC: bad argc on get pos, %i\n", argc);
+      }
+      break;
+    }
+    case COMM_PROTOCOL_GET_PIPE_STATS:
+    {
+      if (argc == 1) {
+        CNC_Pipe_stats_t s;
+        CNC_get_pipe_stats(&s, memtoi(data));
+        u8_t buf[sizeof(u32_t)*3];
+        itomem(s.underruns, &buf[0]);
+        itomem(s.min_depth, &buf[4]);
+        itomem(s.motions, &buf[8]);
         res = COMM_reply(buf, sizeof(buf));
       } else {
-        DBG(D_APP, D_WARN, "COMM_CNC: bad argc on CNC_get_offs_pos, %i\n", argc);
+        DBG(D_APP, D_WARN, "COMM_CNC: bad argc on get pipe stats, %i\n", argc);
       }
       break;
     }
+    case COMM_PROTOCOL_LATCH_BATCH:
+    {
+      if (argc > 0 && (argc % COMM_CNC_MOTION_ARGS) == 0) {
+        if (already_received) {
+          return comm_cnc_handle_already_received_latch_cmd(seq, TRUE);
+        }
+        LED_blink_single(LED_CNC_COMM_BIT, 2,1,2);
+        u32_t first_id = CNC_ERR_LATCH_BUSY;
+        u32_t count = comm_cnc_latch_batch(data, argc / COMM_CNC_MOTION_ARGS, &first_id);
+        if (count > 0) {
+          comm_cnc_store_latch_id(seq, first_id, count);
+        }
+        u8_t buf[sizeof(u32_t)*2];
+        itomem(first_id, &buf[0]);
+        itomem(count, &buf[4]);
+        res = COMM_reply(buf, sizeof(buf));
+      } else {
+        DBG(D_APP, D_WARN, "COMM_CNC: bad argc on CNC_latch_batch, %i\n", argc);
+      }
+      break;
+    }
+#ifdef CONFIG_TIMER_PROFILE
+    case COMM_PROTOCOL_GET_TIMER_PROFILE:
+    {
+      // stage index gives min, avg, max and count of stage,
+      // index TPROF_STAGES gives budget, overruns and overrun histogram
+      u32_t stage = argc == 1 ? memtoi(data) : TPROF_STAGES + 1;
+      if (stage < TPROF_STAGES) {
+        TPROF_stat_t s;
+        TIMER_profile_get(stage, &s);
+        u8_t buf[sizeof(u32_t)*4];
+        itomem(s.count == 0 ? 0 : s.min, &buf[0]);
+        itomem(TPROF_avg(&s), &buf[4]);
+        itomem(s.max, &buf[8]);
+        itomem(s.count, &buf[12]);
+        res = COMM_reply(buf, sizeof(buf));
+      } else if (stage == TPROF_STAGES) {
+        TPROF_hist_t h;
+        TIMER_profile_get_hist(&h);
+        u8_t buf[sizeof(u32_t)*(2+TPROF_HIST_BINS)];
+        int i;
+        itomem(h.budget, &buf[0]);
+        itomem(h.overruns, &buf[4]);
+        for (i = 0; i < TPROF_HIST_BINS; i++) {
+          itomem(h.bins[i], &buf[8+i*4]);
+        }
+        res = COMM_reply(buf, sizeof(buf));
+      } else {
+        DBG(D_APP, D_WARN, "COMM_CNC: bad args on get timer profile, %i\n", argc);
+      }
+      break;
+    }
+#endif
     case COMM_PROTOCOL_CONFIG:
     {
       LED_blink_single(LED_CNC_COMM_BIT, 2,1,2);
+      bool limits = FALSE;
       while (len >= 5) {
         u8_t conf = *data++;
         u32_t conf_val = memtoi(data);
         data += 4;
         CNC_set_config_specific(conf, conf_val);
+        u8_t group = conf & ~COMM_PROTOCOL_CONFIG_AXIS_MASK;
+        limits |= group == COMM_PROTOCOL_CONFIG_SOFT_MIN ||
+            group == COMM_PROTOCOL_CONFIG_SOFT_MAX ||
+            conf == COMM_PROTOCOL_CONFIG_SOFT_LIMITS;
         len -= 5;
       }
+      if (limits) {
+        CONFIG_CNC_limits_store();
+      }
       u8_t buf[sizeof(u32_t)];
       itomem((u32_t)1, buf);
       res = COMM_reply(buf, sizeof(buf));
@@ -348,25 +558,95 @@ void COMM_CNC_on_ack(u16_t seq) {
 void COMM_CNC_on_err(u16_t seq, s32_t err) {
 }
 
-static s32_t comm_cnc_handle_already_received_latch_cmd(u16_t seqno) {
+static s32_t comm_cnc_handle_already_received_latch_cmd(u16_t seqno, bool batch) {
   s32_t res;
-  u8_t buf[4];
+  u8_t buf[8];
   int i;
   for (i = 0; i < COMM_CNC_MAX_STORED_LATCH_IDS; i++) {
     if (stored_latch_ids.seqno[i] == seqno) {
-      itomem(stored_latch_ids.latch_id[i], buf);
+      itomem(stored_latch_ids.latch_id[i], &buf[0]);
+      itomem(stored_latch_ids.count[i], &buf[4]);
       break;
     }
   }
   if (i == COMM_CNC_MAX_STORED_LATCH_IDS) {
     DBG(D_APP, D_WARN, "got a resent latch command whose seq isn't registered %04x\n", seqno);
-    itomem(CNC_ERR_LATCH_BUSY, buf);
+    itomem(CNC_ERR_LATCH_BUSY, &buf[0]);
+    itomem(0, &buf[4]);
   }
-  res = COMM_reply(buf, sizeof(buf));
+  res = COMM_reply(buf, batch ? 8 : 4);
 
   return res;
 }
 
+static void comm_cnc_store_latch_id(u16_t seqno, u32_t id, u32_t count) {
+  stored_latch_ids.seqno[stored_latch_ids.ix] = seqno;
+  stored_latch_ids.latch_id[stored_latch_ids.ix] = id;
+  stored_latch_ids.count[stored_latch_ids.ix] = count;
+  if (stored_latch_ids.ix >= COMM_CNC_MAX_STORED_LATCH_IDS - 1) {
+    stored_latch_ids.ix = 0;
+  } else {
+    stored_latch_ids.ix++;
+  }
+}
+
+// Reads signed steps and frequency of each axis, returns data after them
+static u8_t *comm_cnc_mem_to_axes(u8_t *data, s32_t *steps, u32_t *freq) {
+  int a;
+  for (a = 0; a < AXES_COUNT; a++) {
+    steps[a] = memtoi(data);
+    data += 4;
+    freq[a] = memtoi(data);
+    data += 4;
+  }
+  return data;
+}
+
+// Writes position of each axis
+static void comm_cnc_pos_to_mem(const s32_t *pos, u8_t *buf) {
+  int a;
+  for (a = 0; a < AXES_COUNT; a++) {
+    itomem(pos[a], &buf[a*4]);
+  }
+}
+
+// Latches n motions in latch xyz argument format, returns number of
+// latched motions
+static u32_t comm_cnc_latch_batch(u8_t *data, u32_t n, u32_t *first_id) {
+  u32_t count = 0;
+  while (count < n) {
+    u32_t chunk = MIN(n - count, COMM_CNC_BATCH_CHUNK);
+    u32_t i;
+    for (i = 0; i < chunk; i++) {
+      CNC_Motion_t *m = &batch_motions[i];
+      s32_t steps[AXES_COUNT];
+      u32_t freq[AXES_COUNT];
+      int a;
+      memset(m, 0, sizeof(CNC_Motion_t));
+      data = comm_cnc_mem_to_axes(data, steps, freq);
+      for (a = 0; a < AXES_COUNT; a++) {
+        m->vector[a].dir = steps[a] > 0;
+        m->vector[a].step_count = steps[a] < 0 ? -steps[a] : steps[a];
+        m->vector[a].step_freq = freq[a];
+      }
+      m->rapid = memtoi(data);
+      data += 4;
+    }
+    u32_t id = CNC_ERR_LATCH_BUSY;
+    u32_t latched = CNC_latch_batch(batch_motions, chunk, &id);
+    if (count == 0) {
+      // first id, or why nothing was latched
+      *first_id = id;
+    }
+    count += latched;
+    if (latched < chunk) {
+      // pipe full or outside soft limits
+      break;
+    }
+  }
+  return count;
+}
+
 static void cnc_sr_timer_task(u32_t ignore, void *ignore_more) {
   if (!COMM_SYS_is_connected()) return;
   if (sr_timer_recurrence && pos_timer_recurrence != sr_timer_recurrence) {
@@ -380,32 +660,37 @@ static void cnc_sr_timer_task(u32_t ignore, void *ignore_more) {
 }
 
 static void cnc_pos_timer_task(u32_t ignore, void *ignore_more) {
-  s32 x; s32 y; s32 z;
+  s32_t pos[AXES_COUNT];
   if (!COMM_SYS_is_connected()) return;
   if (pos_timer_recurrence && pos_timer_recurrence != sr_timer_recurrence) {
-    u8_t buf[2 + sizeof(u32_t)*3];
+    u8_t buf[2 + sizeof(u32_t)*AXES_COUNT];
     buf[0] = COMM_PROTOCOL_CNC_ID;
     buf[1] = COMM_PROTOCOL_EVENT_POS_TIMER;
-    CNC_get_pos(&x, &y, &z);
-    itomem(x, &buf[2]);
-    itomem(y, &buf[6]);
-    itomem(z, &buf[10]);
+    CNC_get_pos(pos);
+    comm_cnc_pos_to_mem(pos, &buf[2]);
     COMM_tx(COMM_CONTROLLER_ADDRESS, &buf[0], sizeof(buf), FALSE);
   } else if (pos_timer_recurrence && pos_timer_recurrence == sr_timer_recurrence) {
-    u8_t buf[2 + sizeof(u32_t)*4];
+    u8_t buf[2 + sizeof(u32_t)*(1+AXES_COUNT)];
     buf[0] = COMM_PROTOCOL_CNC_ID;
     buf[1] = COMM_PROTOCOL_EVENT_SR_POS_TIMER;
-    CNC_get_pos(&x, &y, &z);
+    CNC_get_pos(pos);
     u32_t sr = CNC_get_status();
     itomem(sr, &buf[2]);
-    itomem(x, &buf[6]);
-    itomem(y, &buf[10]);
-    itomem(z, &buf[14]);
+    comm_cnc_pos_to_mem(pos, &buf[6]);
     COMM_tx(COMM_CONTROLLER_ADDRESS, &buf[0], sizeof(buf), FALSE);
   }
 }
 
 static void cnc_sr_cb_task(u32_t sr, void *ignore) {
+  CNC_status_leds(sr);
+  if ((sr & ((1<<CNC_STATUS_BIT_MOVEMENT_STILL) | (1<<CNC_STATUS_BIT_MOVEMENT_PAUSE))) ||
+      (sr & (1<<CNC_STATUS_BIT_CONTROL_ENABLED)) == 0) {
+    // motion ended, paused or disabled, store final position
+    CONFIG_CNC_pos_persist();
+  }
+  if (!CNC_status_report(sr)) {
+    return;
+  }
   DBG(D_APP, D_DEBUG, "CNC callb: sr 0b%08b\n", sr);
   u8_t buf[2 + sizeof(u32_t)];
   buf[0] = COMM_PROTOCOL_CNC_ID;
@@ -419,31 +704,96 @@ static void cnc_sr_irq_cb(u32_t sr) {
   TASK_run(t, sr, 0);
 }
 
-static void cnc_pos_irq_cb(s32_t x, s32_t y, s32_t z) {
-  CONFIG_CNC_pos_store(x,y,z);
+static void cnc_persist_timer_task(u32_t ignore, void *ignore_more) {
+  CONFIG_CNC_pos_persist();
 }
 
-static void cnc_offs_irq_cb(s32_t x, s32_t y, s32_t z) {
-  CONFIG_CNC_offs_store(x,y,z);
+static void cnc_pos_irq_cb(const s32_t *pos) {
+  CONFIG_CNC_pos_store(pos);
 }
 
-static void cnc_pipe_cb_task(u32_t id, void *ignore) {
-  DBG(D_APP, D_DEBUG, "CNC callb: pipe id 0x%08x\n", id);
-  u8_t buf[2 + sizeof(u32_t)];
+static void cnc_offs_irq_cb(const s32_t *pos) {
+  CONFIG_CNC_offs_store(pos);
+}
+
+static void cnc_probe_cb_task(u32_t ignore, void *ignore_more) {
+  s32_t pos[AXES_COUNT];
+  CNC_get_probe_pos(pos);
+  DBG(D_APP, D_DEBUG, "CNC callb: probe contact\n");
+  u8_t buf[2 + sizeof(u32_t)*AXES_COUNT];
+  buf[0] = COMM_PROTOCOL_CNC_ID;
+  buf[1] = COMM_PROTOCOL_EVENT_PROBE;
+  comm_cnc_pos_to_mem(pos, &buf[2]);
+  COMM_tx(COMM_CONTROLLER_ADDRESS, &buf[0], sizeof(buf), FALSE);
+}
+
+static void cnc_probe_irq_cb(const s32_t *pos) {
+  // captured position is kept by cnc until probe is armed again
+  task *t = TASK_create(cnc_probe_cb_task, 0);
+  TASK_run(t, 0, 0);
+}
+
+static void cnc_id_timer_task(u32_t ignore, void *ignore_more) {
+  u32_t wix, lost, lost_id, id;
+  // ids are written and lost by irq, snapshot all together so the newest id
+  // always goes with the ring contents it is newer than
+  enter_critical();
+  wix = id_ring.wix;
+  lost = id_ring.lost;
+  lost_id = id_ring.lost_id;
+  id = id_ring.id[(wix - 1) & (COMM_CNC_ID_RING_LEN - 1)];
+  exit_critical();
+  u32_t rix = id_ring.rix;
+  u32_t count = (wix - rix) + (lost - id_ring_lost_seen);
+  if (count == 0) return;
+  if (lost != id_ring_lost_seen) {
+    id = lost_id;
+  }
+  id_ring.rix = wix;
+  id_ring_lost_seen = lost;
+  DBG(D_APP, D_DEBUG, "CNC callb: pipe id 0x%08x, %i motions\n", id, count);
+  // in case no feed task could be queued on drain
+  if (CNC_pipeline_feed_pending()) {
+    CNC_pipeline_feed();
+  }
+  u8_t buf[2 + sizeof(u32_t)*2];
   buf[0] = COMM_PROTOCOL_CNC_ID;
   buf[1] = COMM_PROTOCOL_EVENT_ID;
   itomem(id, &buf[2]);
+  itomem(count, &buf[6]);
   COMM_tx(COMM_CONTROLLER_ADDRESS, &buf[0], sizeof(buf), FALSE);
 }
 
+static void cnc_feed_task(u32_t ignore, void *ignore_more) {
+  feed_pending = FALSE;
+  // pipe has room, feed pending arc segments
+  CNC_pipeline_feed();
+}
+
 static void cnc_pipe_irq_cb(u32_t id) {
-  task *t = TASK_create(cnc_pipe_cb_task, 0);
-  TASK_run(t, id, 0);
+  u32_t wix = id_ring.wix;
+  if (wix - id_ring.rix >= COMM_CNC_ID_RING_LEN) {
+    id_ring.lost_id = id;
+    id_ring.lost++;
+  } else {
+    id_ring.id[wix & (COMM_CNC_ID_RING_LEN - 1)] = id;
+    id_ring.wix = wix + 1;
+  }
+  // feed pipe as it drains while an arc is pending rather than by id timer,
+  // one feed task at a time
+  if (CNC_pipeline_feed_pending() && !feed_pending) {
+    task *t = TASK_create(cnc_feed_task, 0);
+    if (t) {
+      feed_pending = TRUE;
+      TASK_run(t, 0, 0);
+    }
+  }
 }
 
 void COMM_CNC_init() {
   s32_t res;
-  CNC_init(cnc_sr_irq_cb, cnc_pipe_irq_cb, cnc_pos_irq_cb, cnc_offs_irq_cb);
+  CNC_init(cnc_sr_irq_cb, cnc_pipe_irq_cb, cnc_pos_irq_cb, cnc_offs_irq_cb,
+      cnc_probe_irq_cb);
   res = CONFIG_CNC_pos_load();
   if (res != NV_OK) {
     DBG(D_APP, D_WARN, "cnc settings corrupt\n");
@@ -457,6 +807,9 @@ void COMM_CNC_init() {
   print("Non-volatile offset read, res %i\n", res);
 
   memset(&stored_latch_ids, 0xff, sizeof(stored_latch_ids));
+  memset(&id_ring, 0, sizeof(id_ring));
+  id_ring_lost_seen = 0;
+  feed_pending = FALSE;
 
   COMM_SYS_register_event_cb(&event_cb, comm_cnc_event_cb);
 
@@ -466,6 +819,12 @@ void COMM_CNC_init() {
   task_pos = TASK_create(cnc_pos_timer_task, TASK_STATIC);
   TASK_start_timer(task_pos, &task_pos_timer, 0, NULL, 500, 0, "cnc_pos");
   COMM_CNC_apply_pos_timer_recurrence();
+  task_id = TASK_create(cnc_id_timer_task, TASK_STATIC);
+  TASK_start_timer(task_id, &task_id_timer, 0, NULL, id_timer_recurrence,
+      id_timer_recurrence, "cnc_id");
+  task_persist = TASK_create(cnc_persist_timer_task, TASK_STATIC);
+  TASK_start_timer(task_persist, &task_persist_timer, 0, NULL,
+      CNC_POS_PERSIST_PERIOD, CNC_POS_PERSIST_PERIOD, "cnc_persist");
 }
 
 #endif // CONFIG_CNC
@@ -30,24 +30,89 @@
 #define COMM_PROTOCOL_SET_IMM_XYZ         0x0c
 #define COMM_PROTOCOL_SR_TIMER_DELTA      0x0d
 #define COMM_PROTOCOL_POS_TIMER_DELTA     0x0e
+#define COMM_PROTOCOL_LATCH_BATCH         0x0f
 
 #define COMM_PROTOCOL_CONFIG              0x10
+/* Axis configs are a setting group or'ed with axis index + 1 */
+#define COMM_PROTOCOL_CONFIG_AXIS_MASK    0x0f
+#define COMM_PROTOCOL_CONFIG_MAX_FREQ     0x00
+#define COMM_PROTOCOL_CONFIG_RAPID_ACC    0x10
+#define COMM_PROTOCOL_CONFIG_ACC          0x20
+#define COMM_PROTOCOL_CONFIG_START_FREQ   0x30
+#define COMM_PROTOCOL_CONFIG_JERK         0x40
+#define COMM_PROTOCOL_CONFIG_HOME_SEEK    0x60
+#define COMM_PROTOCOL_CONFIG_HOME_LOCATE  0x70
+#define COMM_PROTOCOL_CONFIG_HOME_BACKOFF 0x80
+#define COMM_PROTOCOL_CONFIG_HOME_TRAVEL  0x90
+#define COMM_PROTOCOL_CONFIG_BACKLASH     0xc0
+#define COMM_PROTOCOL_CONFIG_BACKLASH_FREQ 0xd0
+/* Soft limits in steps of machine position, persisted */
+#define COMM_PROTOCOL_CONFIG_SOFT_MIN     0xa0
+#define COMM_PROTOCOL_CONFIG_SOFT_MAX     0xb0
+/* Configs not bound to an axis */
+#define COMM_PROTOCOL_CONFIG_GLOBAL       0x50
 #define COMM_PROTOCOL_CONFIG_MAX_X_FREQ   0x01
 #define COMM_PROTOCOL_CONFIG_MAX_Y_FREQ   0x02
 #define COMM_PROTOCOL_CONFIG_MAX_Z_FREQ   0x03
-#define COMM_PROTOCOL_CONFIG_RAPID_X_D    0x11
-#define COMM_PROTOCOL_CONFIG_RAPID_Y_D    0x12
-#define COMM_PROTOCOL_CONFIG_RAPID_Z_D    0x13
+#define COMM_PROTOCOL_CONFIG_MAX_A_FREQ   0x04
+#define COMM_PROTOCOL_CONFIG_RAPID_ACC_X  0x11
+#define COMM_PROTOCOL_CONFIG_RAPID_ACC_Y  0x12
+#define COMM_PROTOCOL_CONFIG_RAPID_ACC_Z  0x13
+#define COMM_PROTOCOL_CONFIG_RAPID_ACC_A  0x14
+#define COMM_PROTOCOL_CONFIG_ACC_X        0x21
+#define COMM_PROTOCOL_CONFIG_ACC_Y        0x22
+#define COMM_PROTOCOL_CONFIG_ACC_Z        0x23
+#define COMM_PROTOCOL_CONFIG_ACC_A        0x24
+#define COMM_PROTOCOL_CONFIG_START_X_FREQ 0x31
+#define COMM_PROTOCOL_CONFIG_START_Y_FREQ 0x32
+#define COMM_PROTOCOL_CONFIG_START_Z_FREQ 0x33
+#define COMM_PROTOCOL_CONFIG_START_A_FREQ 0x34
+#define COMM_PROTOCOL_CONFIG_JERK_X       0x41
+#define COMM_PROTOCOL_CONFIG_JERK_Y       0x42
+#define COMM_PROTOCOL_CONFIG_JERK_Z       0x43
+#define COMM_PROTOCOL_CONFIG_JERK_A       0x44
+#define COMM_PROTOCOL_CONFIG_JUNCTION_DEV 0x50
+#define COMM_PROTOCOL_CONFIG_ARC_TOLERANCE 0x51
+#define COMM_PROTOCOL_CONFIG_HOME_DIR     0x52
+/* Axes mask of enforced soft limits, persisted */
+#define COMM_PROTOCOL_CONFIG_SOFT_LIMITS  0x53
+/* Pipe depth and motion time in us below which latched motions are slowed */
+#define COMM_PROTOCOL_CONFIG_SLOW_DEPTH   0x54
+#define COMM_PROTOCOL_CONFIG_SLOW_TIME    0x55
 
 #define COMM_PROTOCOL_GET_POS             0x20
 #define COMM_PROTOCOL_SET_OFFS_POS        0x21
 #define COMM_PROTOCOL_GET_OFFS_POS        0x22
+#define COMM_PROTOCOL_GET_TIMER_PROFILE   0x23
+#define COMM_PROTOCOL_LATCH_ARC           0x24
+/* Returns number of axes. Motion and position messages carry one word or
+   word pair per axis, in x, y, z, a order. */
+#define COMM_PROTOCOL_GET_AXES            0x25
+/* Feed override and feed hold take effect at once, not queued in pipe */
+#define COMM_PROTOCOL_FEED_OVERRIDE       0x26
+#define COMM_PROTOCOL_FEED_HOLD           0x27
+/* Arms or disarms probe, contact is reported by COMM_PROTOCOL_EVENT_PROBE */
+#define COMM_PROTOCOL_SET_PROBE           0x28
+#define COMM_PROTOCOL_GET_PROBE_STATUS    0x29
+/* Homes axes mask, see CNC_home */
+#define COMM_PROTOCOL_HOME                0x2a
+/* Returns underruns, min depth and motions of pipe statistics, restarts
+   them if argument is nonzero */
+#define COMM_PROTOCOL_GET_PIPE_STATS      0x2b
+/* Returns timer ticks left of current motion and pipe, see CNC_get_queue_time */
+#define COMM_PROTOCOL_GET_QUEUE_TIME      0x2c
+/* Sets max delay of COMM_PROTOCOL_EVENT_ID in ms, 1 to 1000 */
+#define COMM_PROTOCOL_ID_TIMER_DELTA      0x2d
 
 #define COMM_PROTOCOL_EVENT_SR_TIMER      0xe1
 #define COMM_PROTOCOL_EVENT_POS_TIMER     0xe2
 #define COMM_PROTOCOL_EVENT_SR_POS_TIMER  0xe3
 #define COMM_PROTOCOL_EVENT_SR            0xe4
+/* Id of latest motion leaving the pipe and number of motions leaving the
+   pipe since last event, sent at most once per id timer delta */
 #define COMM_PROTOCOL_EVENT_ID            0xe5
+/* Position captured at probe contact, one word per axis */
+#define COMM_PROTOCOL_EVENT_PROBE         0xe6
 
 #define COMM_PROTOCOL_RESET               0xfe
 
@@ -61,6 +126,9 @@ void COMM_CNC_apply_sr_timer_recurrence();
 void COMM_CNC_set_pos_timer_recurrence(u32_t delta);
 u32_t COMM_CNC_get_pos_timer_recurrence();
 void COMM_CNC_apply_pos_timer_recurrence();
+void COMM_CNC_set_id_timer_recurrence(u32_t delta);
+u32_t COMM_CNC_get_id_timer_recurrence();
+void COMM_CNC_apply_id_timer_recurrence();
 s32_t COMM_CNC_on_pkt(u16_t seq, u8_t *data, u16_t len, bool already_received);
 void COMM_CNC_on_ack(u16_t seq);
 void COMM_CNC_on_err(u16_t seq, s32_t err);
@@ -10,6 +10,9 @@
 #include "system.h"
 #include "comm_proto_cnc.h"
 #include "cnc_control.h"
+#ifdef CONFIG_SPIFFS
+#include "spiffs_wrapper.h"
+#endif
 
 s32_t CONFIG_load() {
   u32_t magic = 0;
@@ -34,6 +37,10 @@ s32_t CONFIG_load() {
     if (res == NV_OK) {
       COMM_CNC_set_pos_timer_recurrence(d);
     }
+    res = NVS_read(NV_RAM, CONFIG_NVR_CNC_ID_TIM_REC_A, &d);
+    if (res == NV_OK) {
+      COMM_CNC_set_id_timer_recurrence(d);
+    }
 #endif
   } else {
     res = NV_ERR_BAD_MAGIC;
@@ -60,6 +67,8 @@ s32_t CONFIG_store() {
     if (res != NV_OK) break;
     res = NVS_write(NV_RAM, CONFIG_NVR_CNC_POS_TIM_REC_A, COMM_CNC_get_pos_timer_recurrence());
     if (res != NV_OK) break;
+    res = NVS_write(NV_RAM, CONFIG_NVR_CNC_ID_TIM_REC_A, COMM_CNC_get_id_timer_recurrence());
+    if (res != NV_OK) break;
 #endif
 
     res = NVS_write(NV_RAM, CONFIG_NVR_MAGIC_A, CONFIG_NVR_MAGIC);
@@ -73,35 +82,54 @@ s32_t CONFIG_store() {
   return res;
 }
 
-s32_t CONFIG_CNC_pos_store(s32_t x, s32_t y, s32_t z) {
+#ifdef CONFIG_CNC
+// sequence number of last committed position slot
+static u16_t pos_seq;
+// last committed position
+static s32_t pos_stored[AXES_COUNT];
+
+s32_t CONFIG_CNC_pos_store(const s32_t *pos) {
   s32_t res;
+  u16_t seq = pos_seq + 1;
+  int a;
   do {
     res = NVS_protect(NV_RAM, FALSE);
     if (res != NV_OK) break;
 
-    res = NVS_write(NV_RAM, CNC_NVR_POS_MAGIC_A, 0);
-    if (res != NV_OK) break;
-
-    res = NVS_write(NV_RAM, CNC_NVR_POS_X_A, x);
-    if (res != NV_OK) break;
-    res = NVS_write(NV_RAM, CNC_NVR_POS_Y_A, y);
-    if (res != NV_OK) break;
-    res = NVS_write(NV_RAM, CNC_NVR_POS_Z_A, z);
+    // fill slot not referred by current sequence
+    for (a = 0; a < AXES_COUNT; a++) {
+      res = NVS_write(NV_RAM, CNC_NVR_POS_AXIS_A(seq, a), pos[a]);
+      if (res != NV_OK) break;
+    }
     if (res != NV_OK) break;
 
-    res = NVS_write(NV_RAM, CNC_NVR_POS_MAGIC_A, CNC_NVR_POS_MAGIC);
+    // commit, a power loss leaves either old or new sequence
+    res = NVS_write(NV_RAM, CNC_NVR_POS_SEQ_A, CNC_NVR_POS_MAGIC | seq);
     if (res != NV_OK) break;
   } while (0);
 
   if (res != NV_OK) {
     DBG(D_ANY, D_WARN, "failed writing nvr pos %i\n", res);
+  } else {
+    pos_seq = seq;
+    memcpy(pos_stored, pos, sizeof(pos_stored));
   }
 
   return res;
 }
 
-s32_t CONFIG_CNC_offs_store(s32_t x, s32_t y, s32_t z) {
+s32_t CONFIG_CNC_pos_persist() {
+  s32_t pos[AXES_COUNT];
+  CNC_get_machine_pos(pos);
+  if (memcmp(pos, pos_stored, sizeof(pos_stored)) == 0) {
+    return NV_OK;
+  }
+  return CONFIG_CNC_pos_store(pos);
+}
+
+s32_t CONFIG_CNC_offs_store(const s32_t *pos) {
   s32_t res;
+  int a;
   do {
     res = NVS_protect(NV_RAM, FALSE);
     if (res != NV_OK) break;
@@ -109,11 +137,10 @@ s32_t CONFIG_CNC_offs_store(s32_t x, s32_t y, s32_t z) {
     res = NVS_write(NV_RAM, CNC_NVR_OFFS_MAGIC_A, 0);
     if (res != NV_OK) break;
 
-    res = NVS_write(NV_RAM, CNC_NVR_OFFS_X_A, x);
-    if (res != NV_OK) break;
-    res = NVS_write(NV_RAM, CNC_NVR_OFFS_Y_A, y);
-    if (res != NV_OK) break;
-    res = NVS_write(NV_RAM, CNC_NVR_OFFS_Z_A, z);
+    for (a = 0; a < AXES_COUNT; a++) {
+      res = NVS_write(NV_RAM, CNC_NVR_OFFS_AXIS_A(a), pos[a]);
+      if (res != NV_OK) break;
+    }
     if (res != NV_OK) break;
 
     res = NVS_write(NV_RAM, CNC_NVR_OFFS_MAGIC_A, CNC_NVR_OFFS_MAGIC);
@@ -127,26 +154,23 @@ s32_t CONFIG_CNC_offs_store(s32_t x, s32_t y, s32_t z) {
   return res;
 }
 
-#ifdef CONFIG_CNC
 s32_t CONFIG_CNC_pos_load() {
   u32_t magic = 0;
   s32_t res;
-  res = NVS_read(NV_RAM, CNC_NVR_POS_MAGIC_A, &magic);
-  if (res == NV_OK && magic == CNC_NVR_POS_MAGIC) {
-    u32_t x, y, z;
-    res = NVS_read(NV_RAM, CNC_NVR_POS_X_A, &x);
-    if (res != NV_OK) {
-      return res;
-    }
-    res = NVS_read(NV_RAM, CNC_NVR_POS_Y_A, &y);
-    if (res != NV_OK) {
-      return res;
-    }
-    res = NVS_read(NV_RAM, CNC_NVR_POS_Z_A, &z);
-    if (res != NV_OK) {
-      return res;
+  res = NVS_read(NV_RAM, CNC_NVR_POS_SEQ_A, &magic);
+  if (res == NV_OK && (magic & CNC_NVR_POS_MAGIC_MASK) == CNC_NVR_POS_MAGIC) {
+    u16_t seq = (u16_t)magic;
+    s32_t pos[AXES_COUNT];
+    int a;
+    for (a = 0; a < AXES_COUNT; a++) {
+      res = NVS_read(NV_RAM, CNC_NVR_POS_AXIS_A(seq, a), (u32_t *)&pos[a]);
+      if (res != NV_OK) {
+        return res;
+      }
     }
-    CNC_config_pos((s32_t)x, (s32_t)y, (s32_t)z);
+    pos_seq = seq;
+    memcpy(pos_stored, pos, sizeof(pos_stored));
+    CNC_config_pos(pos);
   } else {
     res = NV_ERR_BAD_MAGIC;
     DBG(D_ANY, D_WARN, "invalid pos config (magic = %08x)\n", magic);
@@ -159,25 +183,89 @@ s32_t CONFIG_CNC_offs_load() {
   s32_t res;
   res = NVS_read(NV_RAM, CNC_NVR_OFFS_MAGIC_A, &magic);
   if (res == NV_OK && magic == CNC_NVR_OFFS_MAGIC) {
-    u32_t x, y, z;
-    res = NVS_read(NV_RAM, CNC_NVR_OFFS_X_A, &x);
-    if (res != NV_OK) {
-      return res;
+    s32_t pos[AXES_COUNT];
+    int a;
+    for (a = 0; a < AXES_COUNT; a++) {
+      res = NVS_read(NV_RAM, CNC_NVR_OFFS_AXIS_A(a), (u32_t *)&pos[a]);
+      if (res != NV_OK) {
+        return res;
+      }
     }
-    res = NVS_read(NV_RAM, CNC_NVR_OFFS_Y_A, &y);
-    if (res != NV_OK) {
-      return res;
-    }
-    res = NVS_read(NV_RAM, CNC_NVR_OFFS_Z_A, &z);
-    if (res != NV_OK) {
-      return res;
-    }
-    CNC_config_offs_pos((s32_t)x, (s32_t)y, (s32_t)z);
+    CNC_config_offs_pos(pos);
   } else {
     res = NV_ERR_BAD_MAGIC;
     DBG(D_ANY, D_WARN, "invalid offs config (magic = %08x)\n", magic);
   }
   return res;
 }
+
+#ifdef CONFIG_SPIFFS
+typedef struct {
+  u32_t magic;
+  u32_t axes;
+  s32_t min[AXES_COUNT];
+  s32_t max[AXES_COUNT];
+} limits_file;
+
+s32_t CONFIG_CNC_limits_store() {
+  const CNC_Config_t *cfg = CNC_get_config();
+  limits_file f;
+  s32_t res;
+  f.magic = CNC_FILE_LIMITS_MAGIC;
+  f.axes = cfg->soft_limits;
+  memcpy(f.min, cfg->soft_min, sizeof(f.min));
+  memcpy(f.max, cfg->soft_max, sizeof(f.max));
+  spiffs_file fd = SPIFFS_open(FS_get_filesystem(), CNC_FILE_LIMITS,
+      SPIFFS_RDWR | SPIFFS_CREAT | SPIFFS_TRUNC, 0);
+  if (fd < 0) {
+    res = SPIFFS_errno(FS_get_filesystem());
+  } else {
+    res = SPIFFS_write(FS_get_filesystem(), fd, &f, sizeof(f));
+    SPIFFS_close(FS_get_filesystem(), fd);
+  }
+
+  if (res < 0) {
+    DBG(D_ANY, D_WARN, "failed writing soft limits %i\n", res);
+    return res;
+  }
+  return SPIFFS_OK;
+}
+
+s32_t CONFIG_CNC_limits_load() {
+  limits_file f;
+  s32_t res;
+  spiffs_file fd = SPIFFS_open(FS_get_filesystem(), CNC_FILE_LIMITS, SPIFFS_RDONLY, 0);
+  if (fd < 0) {
+    // never configured, soft limits stay off
+    DBG(D_ANY, D_INFO, "no soft limits config\n");
+    return SPIFFS_errno(FS_get_filesystem());
+  }
+  res = SPIFFS_read(FS_get_filesystem(), fd, &f, sizeof(f));
+  SPIFFS_close(FS_get_filesystem(), fd);
+  if (res < 0) {
+    return res;
+  }
+  if (res != sizeof(f) || f.magic != CNC_FILE_LIMITS_MAGIC) {
+    DBG(D_ANY, D_WARN, "invalid soft limits config (magic = %08x)\n", f.magic);
+    return NV_ERR_BAD_MAGIC;
+  }
+  int a;
+  for (a = 0; a < AXES_COUNT; a++) {
+    CNC_set_config_specific(COMM_PROTOCOL_CONFIG_SOFT_MIN | (a + 1), f.min[a]);
+    CNC_set_config_specific(COMM_PROTOCOL_CONFIG_SOFT_MAX | (a + 1), f.max[a]);
+  }
+  // enabled last, when limits are in place
+  CNC_set_config_specific(COMM_PROTOCOL_CONFIG_SOFT_LIMITS, f.axes);
+  return SPIFFS_OK;
+}
+#else
+s32_t CONFIG_CNC_limits_store() {
+  return NV_ERR_ADDR;
+}
+
+s32_t CONFIG_CNC_limits_load() {
+  return NV_ERR_ADDR;
+}
+#endif // CONFIG_SPIFFS
 #endif
 
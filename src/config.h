@@ -18,14 +18,21 @@
 #define CONFIG_NVR_DBG_LEVEL_A        2
 #define CONFIG_NVR_CNC_SR_TIM_REC_A   3
 #define CONFIG_NVR_CNC_POS_TIM_REC_A  4
+/* After the nv cnc info */
+#define CONFIG_NVR_CNC_ID_TIM_REC_A   19
 
 /***** NV CNC info *****/
 
-#define CNC_NVR_POS_MAGIC             0xbeadfeed
-#define CNC_NVR_POS_MAGIC_A           5
-#define CNC_NVR_POS_X_A               6
-#define CNC_NVR_POS_Y_A               7
-#define CNC_NVR_POS_Z_A               8
+/* Position is double buffered in two slots of x, y, z. The sequence word
+   holds magic in upper half and sequence number in lower half, where slot
+   (seq & 1) holds the position of sequence seq. Only the lower half changes
+   when committing a new slot. */
+#define CNC_NVR_POS_MAGIC             0xbead0000
+#define CNC_NVR_POS_MAGIC_MASK        0xffff0000
+#define CNC_NVR_POS_SEQ_A             5
+#define CNC_NVR_POS_SLOT1_A           6
+#define CNC_NVR_POS_SLOT0_A           13
+#define CNC_NVR_POS_SLOT_A(seq)       (((seq) & 1) ? CNC_NVR_POS_SLOT1_A : CNC_NVR_POS_SLOT0_A)
 
 #define CNC_NVR_OFFS_MAGIC            0xc0cac01a
 #define CNC_NVR_OFFS_MAGIC_A          9
@@ -33,11 +40,31 @@
 #define CNC_NVR_OFFS_Y_A              11
 #define CNC_NVR_OFFS_Z_A              12
 
+/* Axes after z keep their position slot words and offset in groups of
+   three after the x, y, z layout */
+#define CNC_NVR_EXT_A                 16
+#define CNC_NVR_POS_AXIS_A(seq, a)    ((a) < 3 ? CNC_NVR_POS_SLOT_A(seq) + (a) : \
+                                       CNC_NVR_EXT_A + ((a) - 3) * 3 + ((seq) & 1))
+#define CNC_NVR_OFFS_AXIS_A(a)        ((a) < 3 ? CNC_NVR_OFFS_X_A + (a) : \
+                                       CNC_NVR_EXT_A + ((a) - 3) * 3 + 2)
+
+/***** CNC info in flash files *****/
+
+/* Soft limits do not fit in nv ram, kept in a spiffs file of magic, axes
+   mask and AXES_COUNT min and max limits */
+#define CNC_FILE_LIMITS               "cnc_limits"
+#define CNC_FILE_LIMITS_MAGIC         0x11e17500
+
 s32_t CONFIG_load();
 s32_t CONFIG_store();
 s32_t CONFIG_CNC_pos_load();
 s32_t CONFIG_CNC_offs_load();
-s32_t CONFIG_CNC_pos_store(s32_t x, s32_t y, s32_t z);
-s32_t CONFIG_CNC_offs_store(s32_t x, s32_t y, s32_t z);
+/* Positions are arrays of AXES_COUNT steps */
+s32_t CONFIG_CNC_pos_store(const s32_t *pos);
+s32_t CONFIG_CNC_pos_persist();
+s32_t CONFIG_CNC_offs_store(const s32_t *pos);
+/* Soft limits need a mounted file system */
+s32_t CONFIG_CNC_limits_load();
+s32_t CONFIG_CNC_limits_store();
 
 #endif /* CONFIG_H_ */
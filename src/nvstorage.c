@@ -117,7 +117,10 @@ static s32_t NV_generic_write_buf(nv_device dev, u32_t a, u32_t *d, u32_t len) {
 
 // NV RAM impl
 
-#define A2BKP(x) ((x) < 9 ? (((x)+1)*4) : (((x)+16)*4))
+// Backup data registers DR1..DR9 and DR20..DR42 hold the first 16 words,
+// DR10..DR19 were left unused and hold the words after
+#define A2BKP(x) ((x) < 9 ? (((x)+1)*4) : (x) < 32 ? (((x)+16)*4) : \
+                  (x) == 32 ? 0x28 : (((x)-17)*4))
 
 static s32_t NV_RAM_read(nv_device dev, u32_t a, u32_t *d) {
   PWR_BackupAccessCmd(ENABLE);
@@ -142,7 +145,8 @@ static s32_t NV_RAM_protect(nv_device dev, char protect) {
 }
 
 static void NV_RAM_init() {
-  NV_RAM_impl.max_size = 42;
+  // 42 backup data registers, two per word
+  NV_RAM_impl.max_size = 21;
   NV_RAM_impl.nv_read = NV_RAM_read;
   NV_RAM_impl.nv_write = NV_RAM_write;
   NV_RAM_impl.nv_read_buf = NV_generic_read_buf;
@@ -7,6 +7,8 @@
 
 #include "processor.h"
 #include "system.h"
+#include "cnc_control.h"
+#include "timer.h"
 
 static void RCC_config() {
 #ifdef CONFIG_UART1
@@ -45,6 +47,13 @@ static void RCC_config() {
   RCC_PCLK1Config(RCC_HCLK_Div1);
 
   RCC_APB1PeriphClockCmd(RCC_APB1Periph_TIM2, ENABLE);
+#ifdef CONFIG_CNC_STEP_TIMER
+  RCC_APB1PeriphClockCmd(CNC_STEP_TIMER_APBPeriph, ENABLE);
+#endif
+#ifdef CONFIG_CNC_DMA_WAVE
+  RCC_APB1PeriphClockCmd(CNC_WAVE_TIMER_APBPeriph, ENABLE);
+  RCC_AHBPeriphClockCmd(CNC_WAVE_DMA_CLK, ENABLE);
+#endif
 
 #ifdef CONFIG_SPI
   /* Enable SPI1_MASTER clock and GPIO clock for SPI1_MASTER */
@@ -102,6 +111,44 @@ static void NVIC_config(void)
   NVIC_SetPriority(STM32_SYSTEM_TIMER_IRQn, NVIC_EncodePriority(prioGrp, 0, 0));
   NVIC_EnableIRQ(STM32_SYSTEM_TIMER_IRQn);
 
+#ifdef CONFIG_CNC_STEP_TIMER
+  // Config & enable CNC step TIM interrupt
+  NVIC_SetPriority(CNC_STEP_TIMER_IRQn, NVIC_EncodePriority(prioGrp, 0, 0));
+  NVIC_EnableIRQ(CNC_STEP_TIMER_IRQn);
+#endif
+#ifdef CONFIG_CNC
+#ifdef CONFIG_CNC_DMA_WAVE
+  // Config & enable CNC limit switch interrupts, same preemption as the wave
+  // DMA interrupt running the cnc engine so position is never captured
+  // halfway through an engine run. No probing in dma wave mode.
+  NVIC_SetPriority(CNC_LIMIT_XYZ_EXTI_IRQn, NVIC_EncodePriority(prioGrp, 1, 1));
+  NVIC_EnableIRQ(CNC_LIMIT_XYZ_EXTI_IRQn);
+#if CNC_AXES > 3
+  NVIC_SetPriority(CNC_LIMIT_A_EXTI_IRQn, NVIC_EncodePriority(prioGrp, 1, 1));
+  NVIC_EnableIRQ(CNC_LIMIT_A_EXTI_IRQn);
+#endif
+#else
+  // Config & enable CNC sense interrupt, same preemption as the timer
+  // running the cnc engine so position is never captured halfway through an
+  // engine run
+  NVIC_SetPriority(CNC_SENSE_EXTI_IRQn, NVIC_EncodePriority(prioGrp, 0, 1));
+  NVIC_EnableIRQ(CNC_SENSE_EXTI_IRQn);
+  // Config & enable CNC limit switch interrupts, likewise
+  NVIC_SetPriority(CNC_LIMIT_XYZ_EXTI_IRQn, NVIC_EncodePriority(prioGrp, 0, 1));
+  NVIC_EnableIRQ(CNC_LIMIT_XYZ_EXTI_IRQn);
+#if CNC_AXES > 3
+  NVIC_SetPriority(CNC_LIMIT_A_EXTI_IRQn, NVIC_EncodePriority(prioGrp, 0, 1));
+  NVIC_EnableIRQ(CNC_LIMIT_A_EXTI_IRQn);
+#endif
+#endif
+#endif
+#ifdef CONFIG_CNC_DMA_WAVE
+  // Config & enable CNC wave DMA interrupt, only needs to refill a buffer
+  // half within one block time
+  NVIC_SetPriority(CNC_WAVE_DMA_IRQn, NVIC_EncodePriority(prioGrp, 1, 0));
+  NVIC_EnableIRQ(CNC_WAVE_DMA_IRQn);
+#endif
+
   // Config & enable uarts interrupt
 #ifdef CONFIG_UART1
   NVIC_SetPriority(USART1_IRQn, NVIC_EncodePriority(prioGrp, 2, 0));
@@ -530,12 +577,121 @@ static void CNC_config() {
       CNC_GPIO_DIR_A | CNC_GPIO_STEP_A |
       CNC_GPIO_DIR_X | CNC_GPIO_STEP_X |
       CNC_GPIO_DIR_Y | CNC_GPIO_STEP_Y |
-      CNC_GPIO_DIR_Z | CNC_GPIO_STEP_Z |
-      CNC_GPIO_SENSE
+      CNC_GPIO_DIR_Z | CNC_GPIO_STEP_Z
       ;
   GPIO_InitStructure.GPIO_Speed = GPIO_Speed_50MHz;
   GPIO_InitStructure.GPIO_Mode = GPIO_Mode_Out_PP;
   GPIO_Init(CNC_GPIO_PORT, &GPIO_InitStructure);
+
+  /* Probe sense input, edge captured by exti */
+  EXTI_InitTypeDef EXTI_InitStructure;
+
+  GPIO_InitStructure.GPIO_Pin = CNC_GPIO_SENSE;
+  GPIO_InitStructure.GPIO_Speed = GPIO_Speed_50MHz;
+  GPIO_InitStructure.GPIO_Mode = GPIO_Mode_IPU;
+  GPIO_Init(CNC_GPIO_PORT, &GPIO_InitStructure);
+
+  GPIO_EXTILineConfig(CNC_SENSE_GPIO_PORT_SOURCE, CNC_SENSE_GPIO_PIN_SOURCE);
+
+  EXTI_InitStructure.EXTI_Line = CNC_SENSE_EXTI_LINE;
+  EXTI_InitStructure.EXTI_Mode = EXTI_Mode_Interrupt;
+  EXTI_InitStructure.EXTI_Trigger = EXTI_Trigger_Falling;
+  EXTI_InitStructure.EXTI_LineCmd = ENABLE;
+  EXTI_Init(&EXTI_InitStructure);
+
+  /* Limit switch inputs, closing edges captured by exti */
+  GPIO_InitStructure.GPIO_Pin =
+      CNC_GPIO_LIMIT_X | CNC_GPIO_LIMIT_Y | CNC_GPIO_LIMIT_Z
+#if CNC_AXES > 3
+      | CNC_GPIO_LIMIT_A
+#endif
+      ;
+  GPIO_InitStructure.GPIO_Speed = GPIO_Speed_50MHz;
+  GPIO_InitStructure.GPIO_Mode = GPIO_Mode_IPU;
+  GPIO_Init(CNC_GPIO_PORT, &GPIO_InitStructure);
+
+  GPIO_EXTILineConfig(CNC_LIMIT_GPIO_PORT_SOURCE, CNC_LIMIT_GPIO_PIN_SOURCE_X);
+  GPIO_EXTILineConfig(CNC_LIMIT_GPIO_PORT_SOURCE, CNC_LIMIT_GPIO_PIN_SOURCE_Y);
+  GPIO_EXTILineConfig(CNC_LIMIT_GPIO_PORT_SOURCE, CNC_LIMIT_GPIO_PIN_SOURCE_Z);
+#if CNC_AXES > 3
+  GPIO_EXTILineConfig(CNC_LIMIT_GPIO_PORT_SOURCE, CNC_LIMIT_GPIO_PIN_SOURCE_A);
+#endif
+
+  EXTI_InitStructure.EXTI_Line =
+      CNC_LIMIT_EXTI_LINE_X | CNC_LIMIT_EXTI_LINE_Y | CNC_LIMIT_EXTI_LINE_Z
+#if CNC_AXES > 3
+      | CNC_LIMIT_EXTI_LINE_A
+#endif
+      ;
+  EXTI_Init(&EXTI_InitStructure);
+
+#ifdef CONFIG_CNC_STEP_TIMER
+  TIM_TimeBaseInitTypeDef  TIM_TimeBaseStructure;
+  TIM_OCInitTypeDef  TIM_OCInitStructure;
+
+  /* Free running time base in step timer resolution */
+  TIM_TimeBaseStructure.TIM_Period = 0xffff;
+  TIM_TimeBaseStructure.TIM_Prescaler = SYS_CPU_FREQ/CNC_STEP_TIMER_FREQ - 1;
+  TIM_TimeBaseStructure.TIM_ClockDivision = 0;
+  TIM_TimeBaseStructure.TIM_CounterMode = TIM_CounterMode_Up;
+
+  TIM_TimeBaseInit(CNC_STEP_TIMER, &TIM_TimeBaseStructure);
+
+  /* Output compare, compare value is advanced by cnc engine on each interrupt */
+  TIM_OCInitStructure.TIM_OCMode = TIM_OCMode_Timing;
+  TIM_OCInitStructure.TIM_OutputState = TIM_OutputState_Disable;
+  TIM_OCInitStructure.TIM_Pulse = CNC_STEP_TIMER_FREQ/1000;
+  TIM_OCInitStructure.TIM_OCPolarity = TIM_OCPolarity_High;
+  TIM_OC1Init(CNC_STEP_TIMER, &TIM_OCInitStructure);
+  TIM_OC1PreloadConfig(CNC_STEP_TIMER, TIM_OCPreload_Disable);
+
+  /* TIM IT enable */
+  TIM_ITConfig(CNC_STEP_TIMER, TIM_IT_CC1, ENABLE);
+
+  /* TIM enable counter */
+  TIM_Cmd(CNC_STEP_TIMER, ENABLE);
+#endif
+#ifdef CONFIG_CNC_DMA_WAVE
+  TIM_TimeBaseInitTypeDef  TIM_TimeBaseStructure;
+  DMA_InitTypeDef DMA_InitStructure;
+
+  /* Prefill both halves, dma streams circularly from start */
+  CNC_wave_fill(0);
+  CNC_wave_fill(1);
+
+  /* Port words memory to port BSRR, one word per timer update */
+  DMA_DeInit(CNC_WAVE_DMA_CHANNEL);
+  DMA_InitStructure.DMA_PeripheralBaseAddr = (uint32_t)&CNC_GPIO_PORT->BSRR;
+  DMA_InitStructure.DMA_MemoryBaseAddr = (uint32_t)CNC_wave_buffer();
+  DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralDST;
+  DMA_InitStructure.DMA_BufferSize = 2*CNC_WAVE_BLOCK;
+  DMA_InitStructure.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+  DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Enable;
+  DMA_InitStructure.DMA_PeripheralDataSize = DMA_PeripheralDataSize_Word;
+  DMA_InitStructure.DMA_MemoryDataSize = DMA_MemoryDataSize_Word;
+  DMA_InitStructure.DMA_Mode = DMA_Mode_Circular;
+  DMA_InitStructure.DMA_Priority = DMA_Priority_VeryHigh;
+  DMA_InitStructure.DMA_M2M = DMA_M2M_Disable;
+  DMA_Init(CNC_WAVE_DMA_CHANNEL, &DMA_InitStructure);
+
+  /* DMA half and complete IT enable */
+  DMA_ITConfig(CNC_WAVE_DMA_CHANNEL, DMA_IT_HT | DMA_IT_TC, ENABLE);
+  DMA_Cmd(CNC_WAVE_DMA_CHANNEL, ENABLE);
+
+  /* Time base configuration, update event each port word */
+  TIM_TimeBaseStructure.TIM_Period = SYS_CPU_FREQ/CNC_WAVE_FREQ - 1;
+  TIM_TimeBaseStructure.TIM_Prescaler = 0;
+  TIM_TimeBaseStructure.TIM_ClockDivision = 0;
+  TIM_TimeBaseStructure.TIM_CounterMode = TIM_CounterMode_Up;
+
+  TIM_TimeBaseInit(CNC_WAVE_TIMER, &TIM_TimeBaseStructure);
+
+  /* TIM update DMA request enable */
+  TIM_DMACmd(CNC_WAVE_TIMER, TIM_DMA_Update, ENABLE);
+
+  /* TIM enable counter */
+  TIM_Cmd(CNC_WAVE_TIMER, ENABLE);
+#endif
 #endif
 }
 
@@ -558,6 +714,10 @@ static void TIM_config() {
   /* TIM IT enable */
   TIM_ITConfig(STM32_SYSTEM_TIMER, TIM_IT_Update, ENABLE);
 
+#ifdef CONFIG_TIMER_PROFILE
+  TIMER_profile_init();
+#endif
+
   /* TIM enable counter */
   TIM_Cmd(STM32_SYSTEM_TIMER, ENABLE);
 }
@@ -4,6 +4,7 @@
 #include "spi_flash_os.h"
 #include "spiffs_wrapper.h"
 #include "heap.h"
+#include "config.h"
 
 #ifdef CONFIG_SPIFFS
 os_mutex fs_mutex;
@@ -25,6 +26,10 @@ static void *spiffs_mounter_f(void *a) {
   print("mounting spiffs..\n");
   FS_mount();
   print("mounted spiffs..\n");
+#ifdef CONFIG_CNC
+  s32_t res = CONFIG_CNC_limits_load();
+  print("Soft limits read, res %i\n", res);
+#endif
   HEAP_free(smi->spiffs_mount_stack);
   HEAP_free(smi);
   return NULL;
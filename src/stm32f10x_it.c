@@ -6,6 +6,7 @@
 #include "enc28j60_spi_eth.h"
 #include "i2c_driver.h"
 #include "usb_istr.h"
+#include "cnc_control.h"
 
 /**
   * @brief  This function handles NMI exception.
@@ -139,6 +140,20 @@ void STM32_SYSTEM_TIMER_IRQ_FN(void)
   //TRACE_IRQ_EXIT(STM32_SYSTEM_TIMER_IRQn);
 }
 
+#ifdef CONFIG_CNC_STEP_TIMER
+void CNC_STEP_TIMER_IRQ_FN(void)
+{
+  TIMER_cnc_step_irq();
+}
+#endif
+
+#ifdef CONFIG_CNC_DMA_WAVE
+void CNC_WAVE_DMA_IRQ_FN(void)
+{
+  TIMER_cnc_wave_irq();
+}
+#endif
+
 #include "miniutils.h"
 
 #ifdef CONFIG_SPI
@@ -168,6 +183,43 @@ void DMA1_Channel5_IRQHandler() {
 }
 #endif
 
+#ifdef CONFIG_CNC
+void CNC_SENSE_EXTI_IRQ_FN(void)
+{
+  TRACE_IRQ_ENTER(CNC_SENSE_EXTI_IRQn);
+  if (EXTI_GetITStatus(CNC_SENSE_EXTI_LINE) != RESET) {
+    EXTI_ClearITPendingBit(CNC_SENSE_EXTI_LINE);
+    CNC_probe_irq();
+  }
+  TRACE_IRQ_EXIT(CNC_SENSE_EXTI_IRQn);
+}
+
+static void cnc_limit_exti(u32_t line, CNC_Axis_t a) {
+  if (EXTI_GetITStatus(line) != RESET) {
+    EXTI_ClearITPendingBit(line);
+    CNC_limit_irq(a);
+  }
+}
+
+void CNC_LIMIT_XYZ_EXTI_IRQ_FN(void)
+{
+  TRACE_IRQ_ENTER(CNC_LIMIT_XYZ_EXTI_IRQn);
+  cnc_limit_exti(CNC_LIMIT_EXTI_LINE_X, X_AXIS);
+  cnc_limit_exti(CNC_LIMIT_EXTI_LINE_Y, Y_AXIS);
+  cnc_limit_exti(CNC_LIMIT_EXTI_LINE_Z, Z_AXIS);
+  TRACE_IRQ_EXIT(CNC_LIMIT_XYZ_EXTI_IRQn);
+}
+
+#if CNC_AXES > 3
+void CNC_LIMIT_A_EXTI_IRQ_FN(void)
+{
+  TRACE_IRQ_ENTER(CNC_LIMIT_A_EXTI_IRQn);
+  cnc_limit_exti(CNC_LIMIT_EXTI_LINE_A, A_AXIS);
+  TRACE_IRQ_EXIT(CNC_LIMIT_A_EXTI_IRQn);
+}
+#endif
+#endif
+
 #ifdef CONFIG_ETHSPI
 void EXTI4_IRQHandler(void)
 {
@@ -107,14 +107,109 @@
 #define CNC_GPIO_STEP_Z       GPIO_Pin_14
 // cnc Z dir pin
 #define CNC_GPIO_DIR_Z        GPIO_Pin_15
-// cnc sense pin
+// cnc sense pin, probe input pulled up, contact pulls low
 #define CNC_GPIO_SENSE        GPIO_Pin_1
-
+#define CNC_SENSE_GPIO_PORT_SOURCE  GPIO_PortSourceGPIOE
+#define CNC_SENSE_GPIO_PIN_SOURCE   GPIO_PinSource1
+#define CNC_SENSE_EXTI_LINE   EXTI_Line1
+#define CNC_SENSE_EXTI_IRQn   EXTI1_IRQn
+#define CNC_SENSE_EXTI_IRQ_FN EXTI1_IRQHandler
+// cnc limit switch pins, pulled up, closed switch pulls low
+#define CNC_GPIO_LIMIT_X      GPIO_Pin_5
+#define CNC_GPIO_LIMIT_Y      GPIO_Pin_6
+#define CNC_GPIO_LIMIT_Z      GPIO_Pin_7
+#define CNC_GPIO_LIMIT_A      GPIO_Pin_3
+#define CNC_LIMIT_GPIO_PORT_SOURCE  GPIO_PortSourceGPIOE
+#define CNC_LIMIT_GPIO_PIN_SOURCE_X GPIO_PinSource5
+#define CNC_LIMIT_GPIO_PIN_SOURCE_Y GPIO_PinSource6
+#define CNC_LIMIT_GPIO_PIN_SOURCE_Z GPIO_PinSource7
+#define CNC_LIMIT_GPIO_PIN_SOURCE_A GPIO_PinSource3
+#define CNC_LIMIT_EXTI_LINE_X EXTI_Line5
+#define CNC_LIMIT_EXTI_LINE_Y EXTI_Line6
+#define CNC_LIMIT_EXTI_LINE_Z EXTI_Line7
+#define CNC_LIMIT_EXTI_LINE_A EXTI_Line3
+#define CNC_LIMIT_XYZ_EXTI_IRQn     EXTI9_5_IRQn
+#define CNC_LIMIT_XYZ_EXTI_IRQ_FN   EXTI9_5_IRQHandler
+#define CNC_LIMIT_A_EXTI_IRQn       EXTI3_IRQn
+#define CNC_LIMIT_A_EXTI_IRQ_FN     EXTI3_IRQHandler
+
+// port access may be predefined, e.g. by a mocked port
+#ifndef CNC_GPIO_DEF
 #define CNC_GPIO_DEF(set, reset) \
   CNC_GPIO_PORT->BSRR = ((set)) | ((reset)<<16)
+#endif
 
+#ifndef CNC_GPIO_DEF_READ
 #define CNC_GPIO_DEF_READ() \
   (CNC_GPIO_PORT->IDR)
+#endif
+
+#ifndef CNC_GPIO_LIMIT_READ
+#define CNC_GPIO_LIMIT_READ() \
+  (CNC_GPIO_PORT->IDR)
+#endif
+
+// number of axes, 3 for x, y and z, 4 adds rotary axis a on its step and dir pins
+#ifndef CNC_AXES
+#define CNC_AXES                  3
+#endif
+
+// number of queued motions, must be a power of two
+#define CNC_PIPE_CAPACITY         256
+
+// max interval in ms of storing a changed position in backup registers while
+// moving, position is also stored whenever motion ends, pauses or is disabled
+#define CNC_POS_PERSIST_PERIOD    250
+
+// planned motions are stepped as coordinated lines, where only the dominant
+// axis runs a timer and minor axes are stepped bresenham style from it
+//#define CONFIG_CNC_BRESENHAM
+
+// cnc engine runs on its own output compare timer, scheduled to fire only
+// when a step pin needs to change instead of on every system timer tick
+//#define CONFIG_CNC_STEP_TIMER
+
+#ifdef CONFIG_CNC_STEP_TIMER
+#define CNC_STEP_TIMER            TIM3
+#define CNC_STEP_TIMER_IRQn       TIM3_IRQn
+#define CNC_STEP_TIMER_IRQ_FN     TIM3_IRQHandler
+#define CNC_STEP_TIMER_APBPeriph  RCC_APB1Periph_TIM3
+// step timer resolution, must divide SYS_CPU_FREQ
+#define CNC_STEP_TIMER_FREQ       200000
+#endif
+
+// cnc engine precomputes blocks of port BSRR words which are streamed to the
+// cnc port by timer triggered dma, giving step pulses without isr jitter
+//#define CONFIG_CNC_DMA_WAVE
+
+#ifdef CONFIG_CNC_DMA_WAVE
+#ifdef CONFIG_CNC_STEP_TIMER
+#error CONFIG_CNC_DMA_WAVE and CONFIG_CNC_STEP_TIMER are mutually exclusive
+#endif
+// TIM4 update event triggers DMA1 channel 7
+#define CNC_WAVE_TIMER            TIM4
+#define CNC_WAVE_TIMER_APBPeriph  RCC_APB1Periph_TIM4
+#define CNC_WAVE_DMA_CLK          RCC_AHBPeriph_DMA1
+#define CNC_WAVE_DMA_CHANNEL      DMA1_Channel7
+#define CNC_WAVE_DMA_IRQn         DMA1_Channel7_IRQn
+#define CNC_WAVE_DMA_IRQ_FN       DMA1_Channel7_IRQHandler
+#define CNC_WAVE_DMA_IT_HT        DMA1_IT_HT7
+#define CNC_WAVE_DMA_IT_TC        DMA1_IT_TC7
+// port word rate, must divide SYS_CPU_FREQ
+#ifndef CNC_WAVE_FREQ
+#define CNC_WAVE_FREQ             100000
+#endif
+// port words per buffer half
+#define CNC_WAVE_BLOCK            128
+#endif
+
+// records changes of the cnc port with engine tick number, see cnc_trace
+//#define CONFIG_CNC_TRACE
+
+#ifdef CONFIG_CNC_TRACE
+// number of recorded port changes, must be a power of two
+#define CNC_TRACE_LEN             256
+#endif
 
 #endif // CONFIG_CNC
 
@@ -315,6 +410,8 @@ typedef u16_t system_counter_type;
 #define SYS_TIMER_TICK_FREQ   1000
 // os ticker cpu clock div
 #define SYS_OS_TICK_DIV       8
+// profile cpu cycles spent in system timer irq
+//#define CONFIG_TIMER_PROFILE
 
 /** COMMUNICATION **/
 
@@ -15,26 +15,130 @@
 #include "led.h"
 #include "os.h"
 
+#ifdef CONFIG_TIMER_PROFILE
+// cycles spent since last mark are accounted to given stage
+#define TPROF_START \
+  u32_t tprof_t0 = DWT->CYCCNT; \
+  u32_t tprof_t = tprof_t0
+#define TPROF_MARK(stage) do { \
+  u32_t c = DWT->CYCCNT; \
+  TPROF_add((stage), c - tprof_t); \
+  tprof_t = c; \
+} while (0)
+#define TPROF_END \
+  TPROF_add_isr(tprof_t - tprof_t0)
+#else
+#define TPROF_START
+#define TPROF_MARK(stage)
+#define TPROF_END
+#endif
+
 void TIMER_irq() {
   if (TIM_GetITStatus(STM32_SYSTEM_TIMER, TIM_IT_Update) != RESET) {
+    TPROF_START;
     TIM_ClearITPendingBit(STM32_SYSTEM_TIMER, TIM_IT_Update);
 
-#ifdef CONFIG_CNC
+#if defined(CONFIG_CNC) && !defined(CONFIG_CNC_STEP_TIMER) && !defined(CONFIG_CNC_DMA_WAVE)
     CNC_timer();
+    TPROF_MARK(TPROF_CNC);
 #endif
     bool ms_update = SYS_timer();
     if (ms_update) {
       TRACE_MS_TICK(SYS_get_time_ms() & 0xff);
     }
+    TPROF_MARK(TPROF_SYS);
 
     TASK_timer();
+    TPROF_MARK(TPROF_TASK);
 #ifdef CONFIG_LED
     LED_SHIFT_tick();
+    TPROF_MARK(TPROF_LED_SHIFT);
     LED_tick();
+    TPROF_MARK(TPROF_LED);
 #endif
     if (ms_update) {
       __os_time_tick(SYS_get_time_ms());
+      TPROF_MARK(TPROF_OS);
     }
     CLI_timer();
+    TPROF_MARK(TPROF_CLI);
+    TPROF_END;
   }
 }
+
+#ifdef CONFIG_TIMER_PROFILE
+void TIMER_profile_init() {
+  // enable cpu cycle counter
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+  TPROF_init(SYS_CPU_FREQ / SYS_MAIN_TIMER_FREQ);
+}
+
+void TIMER_profile_get(enum tprof_stage stage, TPROF_stat_t *s) {
+  enter_critical();
+  TPROF_get_stat(stage, s);
+  exit_critical();
+}
+
+void TIMER_profile_get_hist(TPROF_hist_t *h) {
+  enter_critical();
+  TPROF_get_hist(h);
+  exit_critical();
+}
+
+u32_t TIMER_profile_clear() {
+  enter_critical();
+  TPROF_clear();
+  exit_critical();
+  return 0;
+}
+
+u32_t TIMER_profile_dump() {
+  TPROF_stat_t s;
+  TPROF_hist_t h;
+  int i;
+  print("TIMER profile, cycles\n");
+  for (i = 0; i < TPROF_STAGES; i++) {
+    TIMER_profile_get(i, &s);
+    if (s.count == 0) {
+      continue;
+    }
+    print("  %s\tmin:%i avg:%i max:%i count:%i\n", TPROF_name(i), s.min, TPROF_avg(&s), s.max, s.count);
+  }
+  TIMER_profile_get_hist(&h);
+  print("  budget:%i overruns:%i\n", h.budget, h.overruns);
+  for (i = 0; i < TPROF_HIST_BINS; i++) {
+    print("  >%i:\t%i\n", h.budget + (h.budget * i) / TPROF_HIST_BINS, h.bins[i]);
+  }
+  return 0;
+}
+#endif
+
+#ifdef CONFIG_CNC_STEP_TIMER
+void TIMER_cnc_step_irq() {
+  if (TIM_GetITStatus(CNC_STEP_TIMER, TIM_IT_CC1) != RESET) {
+    TPROF_START;
+    TIM_ClearITPendingBit(CNC_STEP_TIMER, TIM_IT_CC1);
+    u16_t ticks = (u16_t)CNC_step_timer();
+    TPROF_MARK(TPROF_CNC);
+    // move compare relative to last compare, keeping step timing jitter free
+    TIM_SetCompare1(CNC_STEP_TIMER, TIM_GetCapture1(CNC_STEP_TIMER) + ticks);
+    TPROF_END;
+  }
+}
+#endif
+
+#ifdef CONFIG_CNC_DMA_WAVE
+void TIMER_cnc_wave_irq() {
+  // refill the buffer half that dma just finished streaming
+  if (DMA_GetITStatus(CNC_WAVE_DMA_IT_HT) != RESET) {
+    DMA_ClearITPendingBit(CNC_WAVE_DMA_IT_HT);
+    CNC_wave_fill(0);
+  }
+  if (DMA_GetITStatus(CNC_WAVE_DMA_IT_TC) != RESET) {
+    DMA_ClearITPendingBit(CNC_WAVE_DMA_IT_TC);
+    CNC_wave_fill(1);
+  }
+}
+#endif
@@ -8,6 +8,27 @@
 #ifndef TIMER_H_
 #define TIMER_H_
 
+#include "timer_profile.h"
+
 void TIMER_irq();
+void TIMER_cnc_step_irq();
+void TIMER_cnc_wave_irq();
+
+#ifdef CONFIG_TIMER_PROFILE
+/**
+ * Enables the cpu cycle counter and resets timer irq statistics.
+ */
+void TIMER_profile_init();
+/**
+ * Copies timer irq statistics of given stage.
+ */
+void TIMER_profile_get(enum tprof_stage stage, TPROF_stat_t *s);
+/**
+ * Copies timer irq overrun histogram.
+ */
+void TIMER_profile_get_hist(TPROF_hist_t *h);
+u32_t TIMER_profile_clear();
+u32_t TIMER_profile_dump();
+#endif
 
 #endif /* TIMER_H_ */
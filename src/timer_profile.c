@@ -0,0 +1,76 @@
+/*
+ * timer_profile.c
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: agent
+ */
+
+#include "timer_profile.h"
+
+#ifdef CONFIG_TIMER_PROFILE
+
+static TPROF_stat_t stats[TPROF_STAGES];
+static TPROF_hist_t hist;
+
+static const char * const stage_names[TPROF_STAGES] = {
+  "cnc", "sys", "task", "led_shift", "led", "os", "cli", "isr"
+};
+
+void TPROF_init(u32_t budget) {
+  hist.budget = budget;
+  TPROF_clear();
+}
+
+void TPROF_clear() {
+  int i;
+  for (i = 0; i < TPROF_STAGES; i++) {
+    stats[i].min = 0xffffffff;
+    stats[i].max = 0;
+    stats[i].count = 0;
+    stats[i].sum = 0;
+  }
+  hist.overruns = 0;
+  for (i = 0; i < TPROF_HIST_BINS; i++) {
+    hist.bins[i] = 0;
+  }
+}
+
+void TPROF_add(enum tprof_stage stage, u32_t cycles) {
+  TPROF_stat_t *s = &stats[stage];
+  if (cycles < s->min) {
+    s->min = cycles;
+  }
+  if (cycles > s->max) {
+    s->max = cycles;
+  }
+  s->count++;
+  s->sum += cycles;
+}
+
+void TPROF_add_isr(u32_t cycles) {
+  TPROF_add(TPROF_ISR, cycles);
+  if (hist.budget == 0 || cycles <= hist.budget) {
+    return;
+  }
+  hist.overruns++;
+  u32_t bin = (u32_t)(((u64_t)(cycles - hist.budget) * TPROF_HIST_BINS) / hist.budget);
+  hist.bins[MIN(bin, TPROF_HIST_BINS - 1)]++;
+}
+
+void TPROF_get_stat(enum tprof_stage stage, TPROF_stat_t *s) {
+  *s = stats[stage];
+}
+
+void TPROF_get_hist(TPROF_hist_t *h) {
+  *h = hist;
+}
+
+u32_t TPROF_avg(const TPROF_stat_t *s) {
+  return s->count == 0 ? 0 : (u32_t)(s->sum / s->count);
+}
+
+const char *TPROF_name(enum tprof_stage stage) {
+  return stage < TPROF_STAGES ? stage_names[stage] : "?";
+}
+
+#endif // CONFIG_TIMER_PROFILE
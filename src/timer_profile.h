@@ -0,0 +1,89 @@
+/*
+ * timer_profile.h
+ *
+ *  Created on: Oct 17, 2026
+ *      Author: agent
+ */
+
+#ifndef TIMER_PROFILE_H_
+#define TIMER_PROFILE_H_
+
+#include "system.h"
+
+#ifdef CONFIG_TIMER_PROFILE
+
+/**
+ * Cycle statistics of the system timer irq. Samples are cpu cycles as
+ * measured by the caller, this module only aggregates and does not touch
+ * any hardware.
+ */
+
+/* Profiled stages of the system timer irq, in call order */
+enum tprof_stage {
+  // cnc engine, sampled in the step timer irq when that runs the engine
+  TPROF_CNC = 0,
+  TPROF_SYS,
+  TPROF_TASK,
+  TPROF_LED_SHIFT,
+  TPROF_LED,
+  TPROF_OS,
+  TPROF_CLI,
+  TPROF_ISR,
+  TPROF_STAGES
+};
+
+/* Number of overrun histogram bins, each spanning budget/TPROF_HIST_BINS cycles */
+#define TPROF_HIST_BINS     8
+
+typedef struct {
+  u32_t min;
+  u32_t max;
+  u32_t count;
+  u64_t sum;
+} TPROF_stat_t;
+
+typedef struct {
+  // cycles available per irq
+  u32_t budget;
+  // number of irqs exceeding budget
+  u32_t overruns;
+  // number of overruns per excess, last bin also counts excesses beyond budget
+  u32_t bins[TPROF_HIST_BINS];
+} TPROF_hist_t;
+
+/**
+ * Resets all statistics, budget is the number of cycles available per irq.
+ */
+void TPROF_init(u32_t budget);
+/**
+ * Resets all statistics, keeping budget.
+ */
+void TPROF_clear();
+/**
+ * Adds a cycle sample for given stage.
+ */
+void TPROF_add(enum tprof_stage stage, u32_t cycles);
+/**
+ * Adds a cycle sample of the whole irq, also updating the overrun histogram.
+ */
+void TPROF_add_isr(u32_t cycles);
+/**
+ * Copies statistics of given stage.
+ */
+void TPROF_get_stat(enum tprof_stage stage, TPROF_stat_t *s);
+/**
+ * Copies the overrun histogram.
+ */
+void TPROF_get_hist(TPROF_hist_t *h);
+/**
+ * Returns average of given statistics.
+ */
+u32_t TPROF_avg(const TPROF_stat_t *s);
+/**
+ * Returns name of given stage.
+ */
+const char *TPROF_name(enum tprof_stage stage);
+
+#endif // CONFIG_TIMER_PROFILE
+
+#endif /* TIMER_PROFILE_H_ */